@@ -6,6 +6,8 @@
 // simdjson: fastest but only parse; REPIDJSON faster; nlohman::json normal but easy use
 #include "simdjson.h"
 #include "rapidjson/document.h"
+#include "rapidjson/filewritestream.h"
+#include "rapidjson/ostreamwrapper.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/prettywriter.h"
 
@@ -57,8 +59,19 @@ std::string rsaDecrypt(const std::string& sEncryptData, const std::string& sKey)
 }
 
 bool JsonManager::parseRequest(const std::string& sRequestBody) {
+    return parseRequest(sRequestBody.data(), sRequestBody.size(), sRequestBody.capacity());
+}
+
+bool JsonManager::parseRequest(const char* pData, size_t nLength, size_t nCapacity) {
     simdjson::ondemand::parser stParser;
-    simdjson::padded_string stString = simdjson::padded_string(sRequestBody);
+    simdjson::padded_string stCopy;
+    simdjson::padded_string_view stString;
+    if (nCapacity >= nLength + simdjson::SIMDJSON_PADDING) {
+        stString = simdjson::padded_string_view(pData, nLength, nCapacity);
+    } else {
+        stCopy = simdjson::padded_string(pData, nLength);
+        stString = stCopy;
+    }
     simdjson::ondemand::document stDoc = stParser.iterate(stString);
     auto stObject = stDoc.get_object();
     if (stObject.error()) return false;
@@ -127,7 +140,8 @@ bool JsonManager::parseRequest(const std::string& sRequestBody) {
     return false;
 }
 
-void writeContent(rapidjson::PrettyWriter<rapidjson::StringBuffer> &stWriter, const std::string& sFileName) {
+template <typename Writer>
+void writeContent(Writer &stWriter, const std::string& sFileName) {
     stWriter.Key("content");
     stWriter.StartObject();
     stWriter.Key("uri");
@@ -135,7 +149,8 @@ void writeContent(rapidjson::PrettyWriter<rapidjson::StringBuffer> &stWriter, co
     stWriter.EndObject();
 }
 
-void writeBox(rapidjson::PrettyWriter<rapidjson::StringBuffer> &stWriter, const float box[]) {
+template <typename Writer>
+void writeBox(Writer &stWriter, const float box[]) {
     stWriter.Key("boundingVolume");
     stWriter.StartObject();
     {
@@ -149,7 +164,8 @@ void writeBox(rapidjson::PrettyWriter<rapidjson::StringBuffer> &stWriter, const
     stWriter.EndObject();
 }
 
-unsigned writeChildren(rapidjson::PrettyWriter<rapidjson::StringBuffer> &stWriter, const std::vector<StSinglePnts> &vPnts, const std::vector<float> &vErrors, unsigned nParentIdx = 0) {
+template <typename Writer>
+unsigned writeChildren(Writer &stWriter, const std::vector<StSinglePnts> &vPnts, const std::vector<float> &vErrors, unsigned nParentIdx = 0) {
     stWriter.Key("children");
     stWriter.StartArray();
     unsigned nIdx = nParentIdx + 1;
@@ -172,11 +188,11 @@ unsigned writeChildren(rapidjson::PrettyWriter<rapidjson::StringBuffer> &stWrite
     return nIdx;
 }
 
-bool JsonManager::writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<double, 16> transform, float vBox[], const std::string &sOutFileName, float fRootGeometryError) {
-    if (vPnts.size() <= 0) return false;
+// sort tiles parent first, geometric error halves per level down to 0.001 at the leaves
+std::vector<float> prepareTiles(std::vector<StSinglePnts> &vPnts, float fRootGeometryError) {
     std::sort(vPnts.begin(), vPnts.end());
     size_t nMaxLevel = 0;
-    for (auto item : vPnts) {
+    for (const auto& item : vPnts) {
         if (item.nDepth > nMaxLevel) nMaxLevel = item.nDepth;
     }
     std::vector<float> vErrors(nMaxLevel + 1);
@@ -188,9 +204,12 @@ bool JsonManager::writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<d
             vErrors[i] = vErrors[i - 1] / 2.f;
         }
     }
-    
-    rapidjson::StringBuffer stBuf;
-    rapidjson::PrettyWriter<rapidjson::StringBuffer> stWriter(stBuf);
+    return vErrors;
+}
+
+template <typename Writer>
+void writeTileset(Writer &stWriter, const std::vector<StSinglePnts> &vPnts, const std::array<double, 16> &transform, 
+                    const float vBox[], const std::vector<float> &vErrors) {
     stWriter.StartObject();
     {
         stWriter.Key("asset");
@@ -239,13 +258,46 @@ bool JsonManager::writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<d
         stWriter.EndObject();
     }
     stWriter.EndObject();
+}
 
-    std::ofstream file(sOutFileName);
-    if (file) {
-        file << std::setw(4) << stBuf.GetString();
+// pretty (4 spaces) or compact into any rapidjson output stream, the stream does the buffering
+template <typename Stream>
+void writeTilesetTo(Stream &stStream, const std::vector<StSinglePnts> &vPnts, const std::array<double, 16> &transform, 
+                    const float vBox[], const std::vector<float> &vErrors, bool bCompact) {
+    if (bCompact) {
+        rapidjson::Writer<Stream> stWriter(stStream);
+        writeTileset(stWriter, vPnts, transform, vBox, vErrors);
     } else {
+        rapidjson::PrettyWriter<Stream> stWriter(stStream);
+        writeTileset(stWriter, vPnts, transform, vBox, vErrors);
+    }
+    stStream.Flush();
+}
+
+bool JsonManager::writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<double, 16> transform, float vBox[], const std::string &sOutFileName, float fRootGeometryError, bool bCompact) {
+    if (vPnts.size() <= 0) return false;
+    std::vector<float> vErrors = prepareTiles(vPnts, fRootGeometryError);
+
+    // streamed through a fixed buffer, memory does not grow with the tile count
+    FILE* pFile = fopen(sOutFileName.c_str(), "wb");
+    if (pFile == nullptr) {
         printf("Write tileset.json failed\n");
+        return false;
     }
-    file.close();
-    return true;
+    std::vector<char> vBuffer(1 << 16);
+    rapidjson::FileWriteStream stStream(pFile, vBuffer.data(), vBuffer.size());
+    writeTilesetTo(stStream, vPnts, transform, vBox, vErrors, bCompact);
+    bool bOk = (ferror(pFile) == 0);
+    if (fclose(pFile) != 0) bOk = false;
+    if (!bOk) printf("Write tileset.json failed\n");
+    return bOk;
+}
+
+bool JsonManager::writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<double, 16> transform, float vBox[], std::ostream &stOut, float fRootGeometryError, bool bCompact) {
+    if (vPnts.size() <= 0) return false;
+    std::vector<float> vErrors = prepareTiles(vPnts, fRootGeometryError);
+
+    rapidjson::OStreamWrapper stStream(stOut);
+    writeTilesetTo(stStream, vPnts, transform, vBox, vErrors, bCompact);
+    return stOut.good();
 }
\ No newline at end of file
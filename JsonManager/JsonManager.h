@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -87,7 +89,12 @@ public:
     ~JsonManager();
 
     bool parseRequest(const std::string& sRequestBody);
-    bool writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<double, 16> transform, float vBox[], const std::string &sOutFileName, float fRootGeometryError = 32.f);
+    // no copy if nCapacity >= nLength + simdjson::SIMDJSON_PADDING, ex: MinIOManager::downloadToBuffer with padding
+    bool parseRequest(const char* pData, size_t nLength, size_t nCapacity);
+    // streamed to the file, bCompact drops the indentation (smaller, but hard to read by hand)
+    bool writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<double, 16> transform, float vBox[], const std::string &sOutFileName, float fRootGeometryError = 32.f, bool bCompact = false);
+    // same document into any stream, ex: an ostringstream for uploading without a temp file
+    bool writeTilesetJson(std::vector<StSinglePnts> vPnts, std::array<double, 16> transform, float vBox[], std::ostream &stOut, float fRootGeometryError = 32.f, bool bCompact = false);
 
 private:
     JsonManager();
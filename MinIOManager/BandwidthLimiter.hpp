@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// token bucket bandwidth limits, one global bucket shared by all jobs plus an optional bucket per job
+// transfers draw tokens chunk by chunk as they stream, a chunk may overdraw and the debt is waited off
+// by the next one; the global bucket is handed out in weighted fair order (virtual finish time) so one
+// busy job can not starve the others
+
+struct JobThroughput {
+    std::string sJobId;
+    uint64_t nTotalBytes = 0;
+    double fBytesPerSec = 0;        // over the last completed second
+};
+
+class BandwidthLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BandwidthLimiter() : m_stGlobal(0) {}
+
+    BandwidthLimiter(const BandwidthLimiter&) = delete;
+    BandwidthLimiter& operator = (const BandwidthLimiter&) = delete;
+
+    // bytes per second, 0 = unlimited
+    void setGlobalLimit(double fBytesPerSec) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stGlobal.setRate(fBytesPerSec);
+        m_cvWait.notify_all();
+    }
+
+    void setJobLimit(const std::string& sJobId, double fBytesPerSec) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapJobs[sJobId].stBucket.setRate(fBytesPerSec);
+        m_cvWait.notify_all();
+    }
+
+    // share of the global limit relative to the other busy jobs
+    void setJobWeight(const std::string& sJobId, double fWeight) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapJobs[sJobId].fWeight = std::max(fWeight, 1e-3);
+    }
+
+    // block until sJobId may move nBytes more
+    void acquire(const std::string& sJobId, size_t nBytes) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Job& stJob = m_mapJobs[sJobId];
+
+        // own limit first, so a throttled job does not hold up the global queue
+        while (true) {
+            auto stWait = stJob.stBucket.tryTake(nBytes, Clock::now());
+            if (stWait.count() <= 0) break;
+            m_cvWait.wait_for(lock, stWait);
+        }
+
+        if (m_stGlobal.fRate > 0) {
+            // idle jobs do not bank credit, they start at the current virtual time
+            stJob.fVirtual = std::max(stJob.fVirtual, m_fVirtualNow) + nBytes / stJob.fWeight;
+            std::pair<double, uint64_t> stTicket = {stJob.fVirtual, m_nNextTicket++};
+            m_setWaiters.insert(stTicket);
+            while (true) {
+                if (*m_setWaiters.begin() == stTicket) {
+                    auto stWait = m_stGlobal.tryTake(nBytes, Clock::now());
+                    if (stWait.count() <= 0) break;
+                    m_cvWait.wait_for(lock, stWait);
+                } else {
+                    m_cvWait.wait(lock);
+                }
+            }
+            m_setWaiters.erase(stTicket);
+            m_fVirtualNow = stTicket.first;
+            m_cvWait.notify_all();
+        }
+
+        stJob.record(nBytes, Clock::now());
+    }
+
+    std::vector<JobThroughput> throughput() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<JobThroughput> vJobs;
+        auto stNow = Clock::now();
+        for (const auto& item : m_mapJobs) {
+            JobThroughput stJob;
+            stJob.sJobId = item.first;
+            stJob.nTotalBytes = item.second.nTotalBytes;
+            // nothing moved for a while, the last window is stale
+            bool bIdle = (stNow - item.second.stWindowStart > std::chrono::seconds(2));
+            stJob.fBytesPerSec = (bIdle ? 0 : item.second.fLastRate);
+            vJobs.push_back(stJob);
+        }
+        return vJobs;
+    }
+
+private:
+    struct TokenBucket {
+        double fRate = 0;           // bytes per second, 0 = unlimited
+        double fTokens = 0;         // burst is one second worth of tokens, negative while in debt
+        Clock::time_point stLast = Clock::now();
+
+        explicit TokenBucket(double _fRate = 0) : fRate(_fRate), fTokens(_fRate) {}
+
+        void setRate(double _fRate) {
+            fRate = std::max(_fRate, 0.0);
+            fTokens = std::min(fTokens, fRate);
+        }
+
+        // take nBytes if the bucket is not in debt, else how long until it is not
+        std::chrono::microseconds tryTake(size_t nBytes, Clock::time_point stNow) {
+            if (fRate <= 0) return std::chrono::microseconds(0);
+            double fElapsed = std::chrono::duration<double>(stNow - stLast).count();
+            fTokens = std::min(fRate, fTokens + fElapsed * fRate);
+            stLast = stNow;
+            if (fTokens > 0) {
+                fTokens -= nBytes;
+                return std::chrono::microseconds(0);
+            }
+            return std::chrono::microseconds(static_cast<int64_t>(-fTokens / fRate * 1e6) + 1);
+        }
+    };
+
+    struct Job {
+        TokenBucket stBucket;
+        double fWeight = 1.0;
+        double fVirtual = 0;
+        uint64_t nTotalBytes = 0;
+        uint64_t nWindowBytes = 0;
+        Clock::time_point stWindowStart = Clock::now();
+        double fLastRate = 0;
+
+        void record(size_t nBytes, Clock::time_point stNow) {
+            nTotalBytes += nBytes;
+            nWindowBytes += nBytes;
+            double fElapsed = std::chrono::duration<double>(stNow - stWindowStart).count();
+            if (fElapsed >= 1.0) {
+                fLastRate = nWindowBytes / fElapsed;
+                nWindowBytes = 0;
+                stWindowStart = stNow;
+            }
+        }
+    };
+
+    TokenBucket m_stGlobal;
+    std::unordered_map<std::string, Job> m_mapJobs;
+    // (virtual finish time, arrival) of chunks waiting for the global bucket
+    std::set<std::pair<double, uint64_t> > m_setWaiters;
+    double m_fVirtualNow = 0;
+    uint64_t m_nNextTicket = 0;
+    std::condition_variable m_cvWait;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <openssl/evp.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// checksums updated on the buffers as they stream through a transfer, no extra pass over the data
+// crc32c uses sse4.2 when the cpu has it, ranges hashed out of order are joined with combine()
+
+class Crc32c {
+public:
+    static uint32_t extend(uint32_t nCrc, const char* pData, size_t nSize) {
+#if defined(__x86_64__)
+        if (hasHardware()) return extendHardware(nCrc, pData, nSize);
+#endif
+        const auto& vTable = table();
+        nCrc = ~nCrc;
+        for (size_t i = 0; i < nSize; ++i) {
+            nCrc = vTable[(nCrc ^ static_cast<uint8_t>(pData[i])) & 0xff] ^ (nCrc >> 8);
+        }
+        return ~nCrc;
+    }
+
+    // crc of A followed by B from crc(A), crc(B) and len(B), zlib's gf(2) matrix method
+    static uint32_t combine(uint32_t nCrcA, uint32_t nCrcB, size_t nLenB) {
+        if (nLenB == 0) return nCrcA;
+        uint32_t vEven[32];
+        uint32_t vOdd[32];
+        vOdd[0] = 0x82f63b78u;      // reversed castagnoli polynomial
+        uint32_t nRow = 1;
+        for (int i = 1; i < 32; ++i) {
+            vOdd[i] = nRow;
+            nRow <<= 1;
+        }
+        square(vEven, vOdd);        // two zero bits
+        square(vOdd, vEven);        // four zero bits
+        do {
+            square(vEven, vOdd);
+            if (nLenB & 1) nCrcA = times(vEven, nCrcA);
+            nLenB >>= 1;
+            if (nLenB == 0) break;
+            square(vOdd, vEven);
+            if (nLenB & 1) nCrcA = times(vOdd, nCrcA);
+            nLenB >>= 1;
+        } while (nLenB != 0);
+        return nCrcA ^ nCrcB;
+    }
+
+    static std::string toHex(uint32_t nCrc) {
+        char szHex[9];
+        std::snprintf(szHex, sizeof(szHex), "%08x", nCrc);
+        return szHex;
+    }
+
+private:
+    static const std::array<uint32_t, 256>& table() {
+        static const std::array<uint32_t, 256> vTable = [] {
+            std::array<uint32_t, 256> vRes{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t nCrc = i;
+                for (int k = 0; k < 8; ++k) nCrc = (nCrc & 1) ? (nCrc >> 1) ^ 0x82f63b78u : (nCrc >> 1);
+                vRes[i] = nCrc;
+            }
+            return vRes;
+        }();
+        return vTable;
+    }
+
+#if defined(__x86_64__)
+    static bool hasHardware() {
+        static const bool bHas = __builtin_cpu_supports("sse4.2");
+        return bHas;
+    }
+
+    __attribute__((target("sse4.2")))
+    static uint32_t extendHardware(uint32_t nCrc, const char* pData, size_t nSize) {
+        uint64_t nState = ~nCrc;
+        while (nSize >= 8) {
+            uint64_t nWord;
+            std::memcpy(&nWord, pData, 8);
+            nState = _mm_crc32_u64(nState, nWord);
+            pData += 8;
+            nSize -= 8;
+        }
+        uint32_t nState32 = static_cast<uint32_t>(nState);
+        while (nSize-- > 0) nState32 = _mm_crc32_u8(nState32, static_cast<uint8_t>(*pData++));
+        return ~nState32;
+    }
+#endif
+
+    static uint32_t times(const uint32_t* pMat, uint32_t nVec) {
+        uint32_t nSum = 0;
+        while (nVec) {
+            if (nVec & 1) nSum ^= *pMat;
+            nVec >>= 1;
+            ++pMat;
+        }
+        return nSum;
+    }
+
+    static void square(uint32_t* pSquare, const uint32_t* pMat) {
+        for (int i = 0; i < 32; ++i) pSquare[i] = times(pMat, pMat[i]);
+    }
+};
+
+class Md5Stream {
+public:
+    Md5Stream() : m_pCtx(EVP_MD_CTX_new()) {
+        EVP_DigestInit_ex(m_pCtx, EVP_md5(), nullptr);
+    }
+    ~Md5Stream() {
+        EVP_MD_CTX_free(m_pCtx);
+    }
+
+    Md5Stream(const Md5Stream&) = delete;
+    Md5Stream& operator = (const Md5Stream&) = delete;
+
+    void update(const char* pData, size_t nSize) {
+        EVP_DigestUpdate(m_pCtx, pData, nSize);
+    }
+
+    std::string finalHex() {
+        unsigned char szDigest[EVP_MAX_MD_SIZE];
+        unsigned int nLen = 0;
+        EVP_DigestFinal_ex(m_pCtx, szDigest, &nLen);
+        std::string sHex;
+        char szByte[3];
+        for (unsigned int i = 0; i < nLen; ++i) {
+            std::snprintf(szByte, sizeof(szByte), "%02x", szDigest[i]);
+            sHex += szByte;
+        }
+        return sHex;
+    }
+
+private:
+    EVP_MD_CTX* m_pCtx;
+};
+
+// what a download hashes inline, set from the object's metadata
+struct TransferDigest {
+    bool bCrc32c = false;
+    bool bMd5 = false;
+    uint32_t nCrc32c = 0;
+    Md5Stream stMd5;
+    size_t nBytes = 0;
+
+    void update(std::string_view sData) {
+        if (bCrc32c) nCrc32c = Crc32c::extend(nCrc32c, sData.data(), sData.size());
+        if (bMd5) stMd5.update(sData.data(), sData.size());
+        nBytes += sData.size();
+    }
+};
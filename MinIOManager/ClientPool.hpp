@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <miniocpp/client.h>
+
+// one minio client per calling thread instead of one shared by all workers, a client goes back
+// to the pool when its thread exits and is reused by the next one; clients are spread round
+// robin over the endpoints, ex: the nodes of a distributed minio behind no load balancer
+
+class ClientPool {
+public:
+    ClientPool(const std::vector<std::string>& vEndpoints, bool bHttps, const std::string& sAccessKey, const std::string& sSecretKey)
+        : m_pState(std::make_shared<State>(vEndpoints, bHttps, sAccessKey, sSecretKey)), m_nId(s_nNextId++) {}
+
+    ClientPool(const ClientPool&) = delete;
+    ClientPool& operator = (const ClientPool&) = delete;
+
+    // the client of this thread, created or taken from the pool on first use
+    minio::s3::Client& local() {
+        thread_local std::unordered_map<uint64_t, Lease> t_mapLeases;
+        auto itr = t_mapLeases.find(m_nId);
+        if (itr == t_mapLeases.end()) {
+            itr = t_mapLeases.try_emplace(m_nId, m_pState, m_pState->acquire()).first;
+        }
+        return *itr->second.pSlot->pClient;
+    }
+
+    size_t endpointCount() const { return m_pState->vEndpoints.size(); }
+
+    // clients created so far, at most the number of threads that used the pool at once
+    size_t clientCount() const {
+        std::lock_guard<std::mutex> lock(m_pState->mutex);
+        return m_pState->vSlots.size();
+    }
+
+private:
+    struct Slot {
+        std::unique_ptr<minio::s3::BaseUrl> pBaseUrl;
+        std::unique_ptr<minio::s3::Client> pClient;
+    };
+
+    struct State {
+        State(const std::vector<std::string>& _vEndpoints, bool _bHttps, const std::string& sAccessKey, const std::string& sSecretKey)
+            : vEndpoints(_vEndpoints), bHttps(_bHttps), stProvider(sAccessKey, sSecretKey) {}
+
+        Slot* acquire() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!vFree.empty()) {
+                Slot* pSlot = vFree.back();
+                vFree.pop_back();
+                return pSlot;
+            }
+            auto pSlot = std::make_unique<Slot>();
+            std::string sEndpoint = vEndpoints.empty() ? "" : vEndpoints[vSlots.size() % vEndpoints.size()];
+            pSlot->pBaseUrl = std::make_unique<minio::s3::BaseUrl>(sEndpoint, bHttps);
+            pSlot->pClient = std::make_unique<minio::s3::Client>(*pSlot->pBaseUrl, &stProvider);
+            vSlots.push_back(std::move(pSlot));
+            return vSlots.back().get();
+        }
+
+        void release(Slot* pSlot) {
+            std::lock_guard<std::mutex> lock(mutex);
+            vFree.push_back(pSlot);
+        }
+
+        std::vector<std::string> vEndpoints;
+        bool bHttps;
+        minio::creds::StaticProvider stProvider;
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Slot> > vSlots;
+        std::vector<Slot*> vFree;
+    };
+
+    // held by a thread, hands the client back at thread exit if the pool still exists
+    struct Lease {
+        Lease(const std::shared_ptr<State>& pState, Slot* _pSlot) : wpState(pState), pSlot(_pSlot) {}
+        ~Lease() {
+            if (auto pState = wpState.lock()) pState->release(pSlot);
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator = (const Lease&) = delete;
+
+        std::weak_ptr<State> wpState;
+        Slot* pSlot;
+    };
+
+    std::shared_ptr<State> m_pState;
+    uint64_t m_nId;
+    static inline std::atomic<uint64_t> s_nNextId = 0;
+};
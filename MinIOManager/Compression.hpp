@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "TaskManager.hpp"
+
+// gzip for object payloads, large files are cut into chunks compressed on several threads and
+// written as consecutive gzip members (like pigz), which any gzip reader and GzipInflater accept
+
+class GzipInflater {
+public:
+    GzipInflater() {
+        std::memset(&m_stStream, 0, sizeof(m_stStream));
+        // 16 + MAX_WBITS: gzip wrapper only
+        m_bOk = (inflateInit2(&m_stStream, 16 + MAX_WBITS) == Z_OK);
+    }
+    ~GzipInflater() {
+        inflateEnd(&m_stStream);
+    }
+
+    GzipInflater(const GzipInflater&) = delete;
+    GzipInflater& operator = (const GzipInflater&) = delete;
+
+    // inflate sData and pass the output on, false on corrupt input or if funOut returns false
+    bool feed(std::string_view sData, const std::function<bool(std::string_view)>& funOut) {
+        m_stStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(sData.data()));
+        m_stStream.avail_in = static_cast<uInt>(sData.size());
+        while (m_bOk && m_stStream.avail_in > 0) {
+            // next member of a multi member file
+            if (m_bEnded) {
+                inflateReset(&m_stStream);
+                m_bEnded = false;
+            }
+            m_stStream.next_out = reinterpret_cast<Bytef*>(m_szOut);
+            m_stStream.avail_out = sizeof(m_szOut);
+            int nRet = inflate(&m_stStream, Z_NO_FLUSH);
+            if (nRet != Z_OK && nRet != Z_STREAM_END && nRet != Z_BUF_ERROR) {
+                m_bOk = false;
+                break;
+            }
+            size_t nOut = sizeof(m_szOut) - m_stStream.avail_out;
+            if (nOut > 0 && !funOut(std::string_view(m_szOut, nOut))) return false;
+            m_bEnded = (nRet == Z_STREAM_END);
+            if (nRet == Z_BUF_ERROR && nOut == 0) break;
+        }
+        return m_bOk;
+    }
+
+    // the input ended on a member boundary
+    bool finished() const { return m_bOk && m_bEnded; }
+
+private:
+    z_stream m_stStream;
+    char m_szOut[64 << 10];
+    bool m_bOk = false;
+    bool m_bEnded = false;
+};
+
+class GzipCompressor {
+public:
+    static bool compressChunk(const char* pData, size_t nSize, int nLevel, std::string& sOut) {
+        z_stream stStream;
+        std::memset(&stStream, 0, sizeof(stStream));
+        if (deflateInit2(&stStream, nLevel, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+        sOut.resize(deflateBound(&stStream, nSize) + 32);
+        stStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(pData));
+        stStream.avail_in = static_cast<uInt>(nSize);
+        stStream.next_out = reinterpret_cast<Bytef*>(sOut.data());
+        stStream.avail_out = static_cast<uInt>(sOut.size());
+        int nRet = deflate(&stStream, Z_FINISH);
+        sOut.resize(stStream.total_out);
+        deflateEnd(&stStream);
+        return nRet == Z_STREAM_END;
+    }
+
+    // sIn as gzip members of nChunkSize input bytes passed to funOut in order, nThreads chunks in flight,
+    // false if funOut returns false
+    static bool compressFile(const std::string& sIn, int nLevel, size_t nChunkSize, size_t nThreads,
+                        const std::function<bool(std::string_view)>& funOut) {
+        int nFd = open(sIn.c_str(), O_RDONLY);
+        if (nFd < 0) return false;
+        struct stat stStat;
+        if (fstat(nFd, &stStat) != 0) {
+            close(nFd);
+            return false;
+        }
+        size_t nSize = stStat.st_size;
+        void* pMap = (nSize > 0 ? mmap(nullptr, nSize, PROT_READ, MAP_SHARED, nFd, 0) : nullptr);
+        close(nFd);
+        if (pMap == MAP_FAILED) return false;
+        const char* pData = static_cast<const char*>(pMap);
+
+        bool bRes = true;
+        // zlib counts in 32 bits
+        nChunkSize = std::min<size_t>(std::max<size_t>(nChunkSize, 64 << 10), 1ull << 30);
+        nThreads = std::max<size_t>(nThreads, 1);
+        size_t nNumChunks = std::max<size_t>(1, (nSize + nChunkSize - 1) / nChunkSize);
+        // one batch of nThreads chunks at a time keeps memory bounded and the output ordered
+        for (size_t nBatch = 0; bRes && nBatch < nNumChunks; nBatch += nThreads) {
+            size_t nCount = std::min(nThreads, nNumChunks - nBatch);
+            std::vector<std::string> vOut(nCount);
+            std::atomic<bool> bBatchOk = true;
+            if (nCount == 1) {
+                size_t nOffset = nBatch * nChunkSize;
+                bBatchOk = compressChunk(pData + nOffset, std::min(nChunkSize, nSize - nOffset), nLevel, vOut[0]);
+            } else {
+                TaskManager<size_t> stChunkManager(nCount, [&](const size_t& nChunk, const std::atomic<bool>&) {
+                    size_t nOffset = nChunk * nChunkSize;
+                    if (!compressChunk(pData + nOffset, std::min(nChunkSize, nSize - nOffset), nLevel, vOut[nChunk - nBatch])) {
+                        bBatchOk = false;
+                        return false;
+                    }
+                    return true;
+                });
+                for (size_t i = 0; i < nCount; ++i) stChunkManager.addTask(nBatch + i);
+                stChunkManager.start();
+                stChunkManager.waitForComplete();
+            }
+            bRes = bBatchOk;
+            for (size_t i = 0; bRes && i < nCount; ++i) {
+                bRes = funOut(vOut[i]);
+            }
+        }
+        if (pMap != nullptr) munmap(pMap, nSize);
+        return bRes;
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TaskManager.hpp"
+
+// relative paths of the regular files under a directory, sub directories are enumerated concurrently
+// with openat/readdir against the root fd, d_type saves a stat per entry on most filesystems
+
+class DirectoryWalker {
+public:
+    // one call per directory with its files, from several threads at once
+    using FilesFunc = std::function<void(std::vector<std::string>&)>;
+
+    // false if the root or any sub directory could not be read
+    static bool walk(const std::string& sRoot, bool bRecursive, size_t nThreads, const FilesFunc& funOnFiles) {
+        int nRootFd = open(sRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (nRootFd < 0) return false;
+
+        std::atomic<bool> bAllRead = true;
+        {
+            TaskManager<std::string> stWalker(std::max<size_t>(1, nThreads),
+                [&](const std::string& sRelDir, const std::atomic<bool>& bStopFlag) {
+                int nFd = (sRelDir.empty() ? dup(nRootFd) : openat(nRootFd, sRelDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+                DIR* pDir = (nFd < 0 ? nullptr : fdopendir(nFd));
+                if (pDir == nullptr) {
+                    if (nFd >= 0) close(nFd);
+                    bAllRead = false;
+                    return false;
+                }
+
+                std::string sPrefix = (sRelDir.empty() ? "" : sRelDir + "/");
+                std::vector<std::string> vFiles;
+                std::vector<std::string> vSubDirs;
+                while (dirent* pEntry = readdir(pDir)) {
+                    if (bStopFlag) break;
+                    const char* pName = pEntry->d_name;
+                    if (pName[0] == '.' && (pName[1] == '\0' || (pName[1] == '.' && pName[2] == '\0'))) continue;
+
+                    unsigned char nType = pEntry->d_type;
+                    // links and filesystems without d_type, follow like std::filesystem::is_directory
+                    if (nType == DT_UNKNOWN || nType == DT_LNK) {
+                        struct stat stStat;
+                        if (fstatat(dirfd(pDir), pName, &stStat, 0) != 0) continue;
+                        nType = (S_ISDIR(stStat.st_mode) ? DT_DIR : (S_ISREG(stStat.st_mode) ? DT_REG : DT_UNKNOWN));
+                    }
+                    if (nType == DT_DIR) {
+                        if (bRecursive) vSubDirs.push_back(sPrefix + pName);
+                    } else if (nType == DT_REG) {
+                        vFiles.push_back(sPrefix + pName);
+                    }
+                }
+                closedir(pDir);
+
+                // queued before this task completes, so the walker can not finish early
+                if (!vSubDirs.empty()) stWalker.addTasks(vSubDirs);
+                if (!vFiles.empty()) funOnFiles(vFiles);
+                return true;
+            });
+            stWalker.addTask("");
+            stWalker.start();
+            stWalker.waitForComplete();
+        }
+        close(nRootFd);
+        return bAllRead;
+    }
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// short lived cache of bucket existence and object stat results, saves a round trip per transfer
+// only positive answers are kept, a missing bucket or object is asked again next time
+
+struct ObjectMeta {
+    size_t nSize = 0;
+    std::string sEtag;
+    std::string sCodec;         // "codec" user metadata, empty if stored raw
+    std::string sCrc32c;        // "crc32c" user metadata, empty if not tagged
+    bool bEncrypted = false;    // sse-s3/kms/c, the etag is not the content md5 then
+};
+
+class MetadataCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit MetadataCache(std::chrono::milliseconds stTtl = std::chrono::seconds(30)) : m_stTtl(stTtl) {}
+
+    MetadataCache(const MetadataCache&) = delete;
+    MetadataCache& operator = (const MetadataCache&) = delete;
+
+    // ttl <= 0 disables caching
+    void setTtl(std::chrono::milliseconds stTtl) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stTtl = stTtl;
+        if (m_stTtl.count() <= 0) clearLocked();
+    }
+
+    bool bucketExists(const std::string& sBucket) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapBuckets.find(sBucket);
+        if (itr == m_mapBuckets.end()) return false;
+        if (Clock::now() >= itr->second) {
+            m_mapBuckets.erase(itr);
+            return false;
+        }
+        return true;
+    }
+
+    void putBucket(const std::string& sBucket) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stTtl.count() <= 0) return;
+        m_mapBuckets[sBucket] = Clock::now() + m_stTtl;
+    }
+
+    bool stat(const std::string& sBucket, const std::string& sObject, ObjectMeta& stMeta) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapObjects.find(objectKey(sBucket, sObject));
+        if (itr == m_mapObjects.end()) return false;
+        if (Clock::now() >= itr->second.second) {
+            m_mapObjects.erase(itr);
+            return false;
+        }
+        stMeta = itr->second.first;
+        return true;
+    }
+
+    void putStat(const std::string& sBucket, const std::string& sObject, const ObjectMeta& stMeta) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stTtl.count() <= 0) return;
+        m_mapObjects[objectKey(sBucket, sObject)] = {stMeta, Clock::now() + m_stTtl};
+    }
+
+    // also drops the stat entries of the bucket
+    void invalidateBucket(const std::string& sBucket) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapBuckets.erase(sBucket);
+        std::string sPrefix = sBucket + "/";
+        for (auto itr = m_mapObjects.begin(); itr != m_mapObjects.end(); ) {
+            if (itr->first.compare(0, sPrefix.size(), sPrefix) == 0) itr = m_mapObjects.erase(itr);
+            else ++itr;
+        }
+    }
+
+    void invalidateObject(const std::string& sBucket, const std::string& sObject) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapObjects.erase(objectKey(sBucket, sObject));
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        clearLocked();
+    }
+
+private:
+    static std::string objectKey(const std::string& sBucket, const std::string& sObject) {
+        return sBucket + "/" + sObject;
+    }
+
+    void clearLocked() {
+        m_mapBuckets.clear();
+        m_mapObjects.clear();
+    }
+
+private:
+    std::chrono::milliseconds m_stTtl;
+    std::unordered_map<std::string, Clock::time_point> m_mapBuckets;
+    // bucket/object -> (meta, expire)
+    std::unordered_map<std::string, std::pair<ObjectMeta, Clock::time_point> > m_mapObjects;
+    std::mutex m_mutex;
+};
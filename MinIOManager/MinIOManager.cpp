@@ -1,10 +1,17 @@
 #include "MinIOManager.h"
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <unordered_set>
 #include <thread>
 #include <regex>
+#include <cerrno>
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "spdlog/spdlog.h"
 
@@ -14,15 +21,43 @@ MinIOManager::MinIOManager(const std::string& endpoint,
                  bool bHttps,
                  const std::string& access_key, 
                  const std::string& secret_key) : 
-                 m_stBaseUrl(endpoint, bHttps), 
-                 m_stProvider(access_key, secret_key),
-                 m_stClient(m_stBaseUrl, &m_stProvider), 
+                 MinIOManager(std::vector<std::string>{endpoint}, bHttps, access_key, secret_key) {}
+
+MinIOManager::MinIOManager(const std::vector<std::string>& vEndpoints, 
+                 bool bHttps,
+                 const std::string& access_key, 
+                 const std::string& secret_key) : 
+                 m_stClients(vEndpoints, bHttps, access_key, secret_key), 
                 stDownUpManager(5, [this](const MinioTask& stTask, const std::atomic<bool>& bStopFlag) {
             return workerDownUp(stTask, bStopFlag);
-        }) {}
+        }) {
+    if (vEndpoints.empty()) {
+        std::cerr << "no minio endpoint given" << std::endl;
+        m_bValid = false;
+    }
+}
 
 MinIOManager::~MinIOManager() {}
 
+// metadata round trips of this thread, workerDownUp subtracts them from the data transfer time
+static thread_local TransferMetrics::Clock::duration t_stMetaTime{};
+
+class MetaTimer {
+public:
+    MetaTimer(TransferMetrics& stMetrics, const std::string& sBucket)
+        : m_stMetrics(stMetrics), m_sBucket(sBucket), m_tpStart(TransferMetrics::Clock::now()) {}
+    ~MetaTimer() {
+        auto stTime = TransferMetrics::Clock::now() - m_tpStart;
+        t_stMetaTime += stTime;
+        m_stMetrics.addPhase(m_sBucket, TransferPhase::Meta, stTime);
+    }
+
+private:
+    TransferMetrics& m_stMetrics;
+    const std::string& m_sBucket;
+    TransferMetrics::Clock::time_point m_tpStart;
+};
+
 std::string toLower(std::string str) {
     std::transform(str.begin(), str.end(), str.begin(), 
                     [](unsigned char c) { return std::tolower(c); });
@@ -30,14 +65,17 @@ std::string toLower(std::string str) {
 }
 
 bool MinIOManager::bucketExists(const std::string& sBucket) {
+    if (m_stMetaCache.bucketExists(sBucket)) return true;
+    MetaTimer stTimer(m_stMetrics, sBucket);
     try {
         minio::s3::BucketExistsArgs args;
         args.bucket = sBucket;
-        minio::s3::BucketExistsResponse response = m_stClient.BucketExists(args);
+        minio::s3::BucketExistsResponse response = client().BucketExists(args);
         if (!response) {
             spdlog::get("MinIOManager")->critical("Check bucket [{}] failed: {}", sBucket, response.Error().String());
             return false;
         }
+        if (response.exist) m_stMetaCache.putBucket(sBucket);
         return response.exist;
     } catch (const std::exception& e) {
         spdlog::get("MinIOManager")->critical("Check Bucket Exception: {}", e.what());
@@ -46,10 +84,17 @@ bool MinIOManager::bucketExists(const std::string& sBucket) {
 }
 
 bool MinIOManager::makeBucket(const std::string& sBucket) {
+    MetaTimer stTimer(m_stMetrics, sBucket);
     try {
         minio::s3::MakeBucketArgs args;
         args.bucket = sBucket;
-        minio::s3::MakeBucketResponse response = m_stClient.MakeBucket(args);
+        minio::s3::MakeBucketResponse response = client().MakeBucket(args);
+        // another worker made it between our exists check and this call
+        if (!response && response.code != "BucketAlreadyOwnedByYou") {
+            spdlog::get("MinIOManager")->critical("Make Bucket [{}] failed: {}", sBucket, response.Error().String());
+            return false;
+        }
+        m_stMetaCache.putBucket(sBucket);
         return true;
     } catch (const std::exception& e) {
         spdlog::get("MinIOManager")->critical("Make Bucket Exception: {}", e.what());
@@ -61,6 +106,31 @@ bool MinIOManager::makeBucket(const std::string& sBucket) {
 std::vector<std::string> MinIOManager::listObjects(const std::string& sBucket, 
                                     const std::string& sPrefix) {
     std::vector<std::string> vObjects;
+    std::vector<minio::s3::Item> vItems;
+    listObjectItems(sBucket, sPrefix, vItems);
+    for (auto& item : vItems) {
+        vObjects.push_back(std::move(item.name));
+    }
+    return vObjects;
+}
+
+bool MinIOManager::isImageObject(const std::string& sName) const {
+    return m_stImageFilter.matchName(sName);
+}
+
+bool MinIOManager::listObjectItems(const std::string& sBucket, const std::string& sPrefix, 
+                                std::vector<minio::s3::Item>& vObjects, bool bImagesOnly) {
+    return listObjectsPaged(sBucket, sPrefix, (bImagesOnly ? m_stImageFilter : ObjectFilter()), 
+        [&vObjects](std::vector<minio::s3::Item>& vPage) {
+        std::move(vPage.begin(), vPage.end(), std::back_inserter(vObjects));
+        return true;
+    });
+}
+
+bool MinIOManager::listObjectsPaged(const std::string& sBucket, const std::string& sPrefix, const ObjectFilter& stFilter,
+                        const std::function<bool(std::vector<minio::s3::Item>&)>& funOnPage, size_t nPageSize) {
+    PhaseTimer stTimer(m_stMetrics, sBucket, TransferPhase::List);
+    std::vector<minio::s3::Item> vPage;
     try {
         minio::s3::ListObjectsArgs args;
         args.bucket = sBucket;
@@ -69,50 +139,42 @@ std::vector<std::string> MinIOManager::listObjects(const std::string& sBucket,
         }
         args.recursive = true;
 
-        auto result = m_stClient.ListObjects(args);
+        auto result = client().ListObjects(args);
         for (; result; result++) {
             minio::s3::Item item = *result;
             if (!item) {
-                break;
+                spdlog::get("MinIOManager")->critical("List [{}/{}] failed: {}", sBucket, sPrefix, item.Error().String());
+                return false;
             }
             
-            size_t nDotPos = item.name.find_last_of('.');
-            if (nDotPos == std::string::npos) continue;
-            std::string ext = toLower(item.name.substr(nDotPos + 1));
-            auto itr = m_setImageExtensions.find(ext);
-            if (itr == m_setImageExtensions.end()) continue;
+            if (!stFilter.match(item)) continue;
 
-            vObjects.push_back(item.name);
+            vPage.push_back(std::move(item));
+            if (vPage.size() >= nPageSize) {
+                if (!funOnPage(vPage)) return true;
+                vPage.clear();
+            }
         }
     } catch (const std::exception& e) {
         std::cerr << "Exception: " << e.what() << std::endl;
+        return false;
     }
     
-    return vObjects;
+    if (!vPage.empty()) funOnPage(vPage);
+    return true;
 }
 
 std::vector<std::string> MinIOManager::listFiles(const std::string& sLocalPath, const std::string& sPrefix, bool bRecursive ) {
     std::vector<std::string> sFiles;
-    std::string sNewLocalPath = sLocalPath + "/" + sPrefix;
-    // printf("%s %s %s\n", sLocalPath.c_str(), sPrefix.c_str(), sNewLocalPath.c_str());
-    for (auto& fileName : std::filesystem::directory_iterator(sNewLocalPath))  {
-        std::string sNameOnly = fileName.path().filename().string();
-        std::string sFullName = fileName.path().string();
-            
-        std::string sNewPrefix = (sPrefix.empty() ? "" : sPrefix + "/") + sNameOnly;
-
-        if (fileName.is_directory()) {
-            if (bRecursive) {
-                std::vector<std::string> sSubFiles = listFiles(sLocalPath, sNewPrefix, bRecursive);
-                sFiles.insert(sFiles.end(), sSubFiles.begin(), sSubFiles.end());
-            } 
-            else {
-                continue;
-            }
-        } else {
-            sFiles.push_back(sNewPrefix);
+    std::mutex mutexFiles;
+    std::string sNewPrefix = (sPrefix.empty() ? "" : sPrefix + "/");
+    DirectoryWalker::walk(sLocalPath + "/" + sPrefix, bRecursive, m_nScanThreads, [&](std::vector<std::string>& vFiles) {
+        std::lock_guard<std::mutex> lock(mutexFiles);
+        for (auto& sName : vFiles) {
+            if (isPartialFile(sName)) continue;
+            sFiles.push_back(sNewPrefix + sName);
         }
-    }
+    });
     return sFiles;
 }
 
@@ -126,12 +188,27 @@ bool MinIOManager::downloadObject(const std::string& sBucket,
         if (!std::filesystem::exists(fsPath.parent_path()))
             std::filesystem::create_directories(fsPath.parent_path());
 
+        // a plain download never stats first, the size comes from the codec stat or the metadata cache
+        ObjectMeta stMeta;
+        bool bKnownSize = (m_stCompressOptions.bDecompress ? statObject(sBucket, sObject, stMeta) 
+                        : m_stMetaCache.stat(sBucket, sObject, stMeta));
+        if (m_stCompressOptions.bDecompress && bKnownSize && stMeta.sCodec == "gzip") {
+            return downloadDecompressed(sBucket, sObject, sSavePath);
+        }
+        if (m_pObjectCache) return downloadCached(sBucket, sObject, sSavePath, 0, "");
+        if (m_stVerifyOptions.bEnabled) return downloadVerified(sBucket, sObject, sSavePath);
+
+        if (m_stRangedOptions.nThreshold > 0 && bKnownSize && stMeta.nSize >= m_stRangedOptions.nThreshold) {
+            return downloadObjectRanged(sBucket, sObject, sSavePath);
+        }
+
         minio::s3::DownloadObjectArgs args;
         args.bucket = sBucket;
         args.object = sObject;
         args.filename = sSavePath;
+        args.progressfunc = throttleProgress(false);
 
-        auto response = m_stClient.DownloadObject(args);
+        auto response = client().DownloadObject(args);
         if (!response) {
             spdlog::get("MinIOManager")->critical("Download [{}] failed: {}", sObject, response.Error().String());
             return false;
@@ -149,24 +226,1353 @@ bool MinIOManager::uploadObject(const std::string &sBucket, const std::string &s
             return false;
         }
     }
+    if (shouldCompress(sLocalPathName)) return uploadCompressed(sBucket, sObject, sLocalPathName);
+    std::error_code ec;
+    size_t nFileSize = std::filesystem::file_size(sLocalPathName, ec);
+    if (!ec && nFileSize > 0 && nFileSize >= m_stMultipartOptions.nThreshold) {
+        return uploadObjectMultipart(sBucket, sObject, sLocalPathName);
+    }
     try {
         minio::s3::UploadObjectArgs args;
         args.bucket = sBucket;
         args.object = sObject;
         args.filename = sLocalPathName;
+        args.progressfunc = throttleProgress(true);
+        std::string sCrc32c = uploadChecksum(sLocalPathName);
+        if (!sCrc32c.empty()) args.user_metadata.Add("crc32c", sCrc32c);
 
-        minio::s3::UploadObjectResponse response = m_stClient.UploadObject(args);
+        minio::s3::UploadObjectResponse response = client().UploadObject(args);
         if (!response) {
             spdlog::get("MinIOManager")->critical("Upload [{}] failed: {}", sLocalPathName, response.Error().String());
             return false;
         }
+        m_stMetaCache.invalidateObject(sBucket, sObject);
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Upload Exception: {}", e.what());
+        return false;
+    }
+    return true;
+}
+
+void MinIOManager::setMultipartOptions(const MultipartOptions& stOptions) {
+    m_stMultipartOptions = stOptions;
+}
+
+bool MinIOManager::uploadObjectMultipart(const std::string &sBucket, const std::string &sObject, const std::string &sLocalPathName) {
+    return uploadObjectMultipart(sBucket, sObject, sLocalPathName, true);
+}
+
+bool MinIOManager::uploadObjectMultipart(const std::string &sBucket, const std::string &sObject, 
+                        const std::string &sLocalPathName, bool bAllowResume) {
+    int nFd = open(sLocalPathName.c_str(), O_RDONLY);
+    if (nFd < 0) {
+        spdlog::get("MinIOManager")->critical("Upload [{}] failed: open {}", sLocalPathName, std::strerror(errno));
+        return false;
+    }
+    struct stat stStat;
+    if (fstat(nFd, &stStat) != 0 || stStat.st_size == 0) {
+        spdlog::get("MinIOManager")->critical("Upload [{}] failed: empty or unreadable file", sLocalPathName);
+        close(nFd);
+        return false;
+    }
+    size_t nFileSize = stStat.st_size;
+    // parts are views into the mapping, the file is never copied into memory as a whole
+    void* pMap = mmap(nullptr, nFileSize, PROT_READ, MAP_SHARED, nFd, 0);
+    close(nFd);
+    if (pMap == MAP_FAILED) {
+        spdlog::get("MinIOManager")->critical("Upload [{}] failed: mmap {}", sLocalPathName, std::strerror(errno));
+        return false;
+    }
+    madvise(pMap, nFileSize, MADV_SEQUENTIAL);
+    const char* pData = static_cast<const char*>(pMap);
+
+    // s3: at least 5MB per part except the last, at most 10000 parts
+    size_t nPartSize = std::max<size_t>(m_stMultipartOptions.nPartSize, 5ull << 20);
+    nPartSize = std::max<size_t>(nPartSize, (nFileSize + 9999) / 10000);
+    size_t nNumParts = (nFileSize + nPartSize - 1) / nPartSize;
+
+    // the checkpoint is only valid for the same file content and part layout
+    bool bCheckpoint = m_stCheckpointOptions.bEnabled;
+    TransferCheckpoint stCheckpoint(bCheckpoint ? checkpointPath(sLocalPathName, "multipart") : "");
+    std::string sHeader = "multipart " + std::to_string(nFileSize) + " " + std::to_string(stStat.st_mtime) + " " 
+                        + std::to_string(nPartSize) + " " + sBucket + "/" + sObject;
+    bool bResumed = false;
+    std::atomic<bool> bNoSuchUpload = false;
+
+    bool bRes = false;
+    try {
+        std::string sUploadId;
+        // each part writes only its own slot
+        std::vector<std::string> vEtags(nNumParts);
+        std::vector<std::string> vLines;
+        if (bCheckpoint && bAllowResume && stCheckpoint.load(sHeader, vLines, m_stCheckpointOptions.nStaleSeconds) 
+            && !vLines.empty() && stCheckpoint.resume()) {
+            // first line is the upload id, then "<part number> <etag>"
+            sUploadId = vLines[0];
+            for (size_t i = 1; i < vLines.size(); ++i) {
+                size_t nSpace = vLines[i].find(' ');
+                if (nSpace == std::string::npos) continue;
+                size_t nPart = std::strtoull(vLines[i].c_str(), nullptr, 10);
+                if (nPart >= 1 && nPart <= nNumParts) vEtags[nPart - 1] = vLines[i].substr(nSpace + 1);
+            }
+            bResumed = true;
+            spdlog::get("MinIOManager")->info("Upload [{}] resumes {} with {}/{} parts done", sLocalPathName, sUploadId, 
+                nNumParts - std::count(vEtags.begin(), vEtags.end(), std::string()), nNumParts);
+        } else {
+            if (std::filesystem::exists(stCheckpoint.path())) {
+                abortCheckpointedUpload(stCheckpoint.path());
+                stCheckpoint.remove();
+            }
+            // one crc pass over the map at memory speed, metadata can only be set when the upload is created
+            std::string sCrc32c = (m_stVerifyOptions.bEnabled ? Crc32c::toHex(Crc32c::extend(0, pData, nFileSize)) : "");
+            sUploadId = createMultipart(sBucket, sObject, sLocalPathName, sCrc32c);
+            if (sUploadId.empty()) {
+                munmap(pMap, nFileSize);
+                return false;
+            }
+            if (bCheckpoint && stCheckpoint.begin(sHeader)) stCheckpoint.append(sUploadId);
+        }
+
+        {
+            TaskManager<MinioPartTask> stPartManager(std::max<size_t>(1, std::min(m_stMultipartOptions.nPartConcurrency, nNumParts)), 
+                [&](const MinioPartTask& stPart, const std::atomic<bool>& bStopFlag) {
+                std::string sEtag;
+                if (!uploadPart(sBucket, sObject, sUploadId, stPart.nPartNumber, std::string_view(pData + stPart.nOffset, stPart.nLength), 
+                        bStopFlag, sLocalPathName, sEtag, bNoSuchUpload)) {
+                    return false;
+                }
+                vEtags[stPart.nPartNumber - 1] = sEtag;
+                if (bCheckpoint) stCheckpoint.append(std::to_string(stPart.nPartNumber) + " " + sEtag);
+                return true;
+            });
+            for (size_t i = 0; i < nNumParts; ++i) {
+                if (!vEtags[i].empty()) continue;
+                MinioPartTask stPart;
+                stPart.nPartNumber = i + 1;
+                stPart.nOffset = i * nPartSize;
+                stPart.nLength = std::min(nPartSize, nFileSize - stPart.nOffset);
+                stPartManager.addTask(stPart);
+            }
+            stPartManager.start();
+            stPartManager.waitForComplete();
+        }
+
+        bRes = completeMultipart(sBucket, sObject, sUploadId, vEtags, sLocalPathName, bNoSuchUpload);
+        if (bRes) {
+            stCheckpoint.remove();
+        } else if (bCheckpoint && !bNoSuchUpload) {
+            // keep the upload and its parts for the next attempt
+            spdlog::get("MinIOManager")->warn("Upload [{}] checkpointed in {}", sLocalPathName, stCheckpoint.path());
+        } else {
+            stCheckpoint.remove();
+            abortMultipart(sBucket, sObject, sUploadId);
+        }
     } catch (const std::exception& e) {
         spdlog::get("MinIOManager")->critical("Upload Exception: {}", e.what());
+        bRes = false;
+    }
+    munmap(pMap, nFileSize);
+    // the server forgot the checkpointed upload, ex: expired by lifecycle rules, start over once
+    if (!bRes && bResumed && bNoSuchUpload) {
+        m_stMetrics.addRetry(sBucket);
+        return uploadObjectMultipart(sBucket, sObject, sLocalPathName, false);
+    }
+    return bRes;
+}
+
+void MinIOManager::setPackOptions(const PackOptions& stOptions) {
+    m_stPackOptions = stOptions;
+}
+
+void MinIOManager::setCompressionOptions(const CompressionOptions& stOptions) {
+    m_stCompressOptions = stOptions;
+}
+
+bool MinIOManager::shouldCompress(const std::string& sLocalPathName) const {
+    if (!m_stCompressOptions.bCompress || !m_stCompressOptions.stFilter.matchName(sLocalPathName)) return false;
+    std::error_code ec;
+    size_t nFileSize = std::filesystem::file_size(sLocalPathName, ec);
+    return !ec && nFileSize >= m_stCompressOptions.nMinSize;
+}
+
+bool MinIOManager::uploadCompressed(const std::string& sBucket, const std::string& sObject, const std::string& sLocalPathName) {
+    bool bCompressed = true;
+    // members go out as parts while later chunks compress, the gzip member crcs cover the content
+    bool bRes = uploadStream(sBucket, sObject, [&](const std::function<bool(std::string_view)>& funWrite) {
+        bool bWritten = true;
+        // a failed part stops compression too, that is not a compress error
+        bCompressed = GzipCompressor::compressFile(sLocalPathName, m_stCompressOptions.nLevel, 
+            m_stCompressOptions.nChunkSize, m_stCompressOptions.nThreads, [&](std::string_view sMember) {
+            bWritten = funWrite(sMember);
+            return bWritten;
+        }) || !bWritten;
+        return bCompressed && bWritten;
+    }, "gzip");
+    if (!bCompressed) {
+        spdlog::get("MinIOManager")->critical("Upload [{}] failed: compress", sLocalPathName);
+    }
+    return bRes;
+}
+
+bool MinIOManager::downloadDecompressed(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath) {
+    std::filesystem::path fsPath(sSavePath);
+    if (fsPath.has_parent_path() && !std::filesystem::exists(fsPath.parent_path()))
+        std::filesystem::create_directories(fsPath.parent_path());
+    std::string sTmpPath = sSavePath + ".inflate";
+    std::ofstream fsOut(sTmpPath, std::ios::binary | std::ios::trunc);
+    if (!fsOut.is_open()) return false;
+
+    GzipInflater stInflater;
+    bool bRes = false;
+    try {
+        minio::s3::GetObjectArgs args;
+        args.bucket = sBucket;
+        args.object = sObject;
+        args.datafunc = [&](minio::http::DataFunctionArgs stArgs) -> bool {
+            throttle(stArgs.datachunk.size());
+            return stInflater.feed(stArgs.datachunk, [&fsOut](std::string_view sData) {
+                return static_cast<bool>(fsOut.write(sData.data(), sData.size()));
+            });
+        };
+        auto response = client().GetObject(args);
+        fsOut.close();
+        bRes = (response && stInflater.finished() && !fsOut.fail());
+        if (!bRes) {
+            spdlog::get("MinIOManager")->critical("Download [{}] failed: {}", sObject, 
+                (response ? std::string("corrupt gzip payload") : response.Error().String()));
+        }
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Download Exception: {}", e.what());
+    }
+    std::error_code ec;
+    if (bRes) std::filesystem::rename(sTmpPath, sSavePath, ec);
+    else std::filesystem::remove(sTmpPath, ec);
+    return bRes && !ec;
+}
+
+// read-only istream buffer over memory owned by the caller, no copy of the payload
+class ViewStreamBuf : public std::streambuf {
+public:
+    explicit ViewStreamBuf(std::string_view sData) {
+        char* pBegin = const_cast<char*>(sData.data());
+        setg(pBegin, pBegin, pBegin + sData.size());
+    }
+
+protected:
+    pos_type seekoff(off_type nOff, std::ios_base::seekdir eDir, std::ios_base::openmode eMode) override {
+        if (!(eMode & std::ios_base::in)) return pos_type(off_type(-1));
+        off_type nBase = (eDir == std::ios_base::beg ? 0 : (eDir == std::ios_base::cur ? gptr() - eback() : egptr() - eback()));
+        return seekpos(pos_type(nBase + nOff), eMode);
+    }
+
+    pos_type seekpos(pos_type nPos, std::ios_base::openmode eMode) override {
+        off_type nOff = off_type(nPos);
+        if (!(eMode & std::ios_base::in) || nOff < 0 || nOff > egptr() - eback()) return pos_type(off_type(-1));
+        setg(eback(), eback() + nOff, egptr());
+        return nPos;
+    }
+};
+
+bool MinIOManager::putBuffer(const std::string& sBucket, const std::string& sObject, std::string_view sData,
+                        const std::string& sCodec) {
+    try {
+        throttle(sData.size());
+        ViewStreamBuf stBuf(sData);
+        std::istream ssData(&stBuf);
+        minio::s3::PutObjectArgs args(ssData, static_cast<long>(sData.size()), 0);
+        args.bucket = sBucket;
+        args.object = sObject;
+        if (!sCodec.empty()) {
+            args.user_metadata.Add("codec", sCodec);
+            // http clients reading the bucket directly inflate it, minio-cpp downloads stay raw
+            args.headers.Add("Content-Encoding", sCodec);
+        }
+        if (m_stVerifyOptions.bEnabled) {
+            args.user_metadata.Add("crc32c", Crc32c::toHex(Crc32c::extend(0, sData.data(), sData.size())));
+        }
+        auto response = client().PutObject(args);
+        if (!response) {
+            spdlog::get("MinIOManager")->critical("Put [{}] failed: {}", sObject, response.Error().String());
+            return false;
+        }
+        m_stMetaCache.invalidateObject(sBucket, sObject);
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Put Exception: {}", e.what());
         return false;
     }
     return true;
 }
 
+int MinIOManager::uploadDirectoryPacked(const std::string& sBucket,
+                        const std::string& sObject,
+                        const std::string& sLocalPath,
+                        bool bRecursive) {
+    if (!std::filesystem::exists(sLocalPath)) {
+        std::cerr << "local path '" << sLocalPath << "' not found or unaccessable" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!bucketExists(sBucket)) {
+        if (!makeBucket(sBucket)) {
+            return EXIT_FAILURE;
+        }
+    }
+    try {
+        // small files with their sizes, large ones start uploading during the scan
+        std::mutex mutexScan;
+        std::vector<std::pair<std::string, size_t> > vSmall;
+        stDownUpManager.takeFailedTasks();
+        stDownUpManager.beginFeed();
+        stDownUpManager.start();
+        bool bScanned = DirectoryWalker::walk(sLocalPath, bRecursive, m_nScanThreads, [&](std::vector<std::string>& vFiles) {
+            std::vector<MinioTask> vTasks;
+            std::vector<std::pair<std::string, size_t> > vPack;
+            for (const auto& sName : vFiles) {
+                if (isPartialFile(sName)) continue;
+                std::error_code ec;
+                size_t nSize = std::filesystem::file_size(sLocalPath + "/" + sName, ec);
+                if (ec) continue;
+                if (nSize <= m_stPackOptions.nMaxMemberSize) vPack.push_back({sName, nSize});
+                else vTasks.push_back({sBucket, sObject + "/" + sName, sLocalPath + "/" + sName, true});
+            }
+            for (auto& stTask : vTasks) prioritize(stTask);
+            stDownUpManager.addTasks(vTasks);
+            std::lock_guard<std::mutex> lock(mutexScan);
+            vSmall.insert(vSmall.end(), vPack.begin(), vPack.end());
+        });
+        stDownUpManager.endFeed();
+
+        // sorted so neighbours in the tree share an archive, ex: one tile level
+        std::sort(vSmall.begin(), vSmall.end());
+        PackIndex stIndex;
+        std::vector<PackArchiveTask> vArchives;
+        size_t nOffset = 0;
+        for (const auto& item : vSmall) {
+            if (vArchives.empty() || (nOffset > 0 && nOffset + item.second > m_stPackOptions.nArchiveSize)) {
+                vArchives.push_back(PackArchiveTask());
+                vArchives.back().nArchive = static_cast<uint32_t>(vArchives.size() - 1);
+                nOffset = 0;
+            }
+            vArchives.back().vMembers.push_back(item.first);
+            stIndex.add(item.first, {vArchives.back().nArchive, nOffset, item.second});
+            nOffset += item.second;
+        }
+
+        std::atomic<bool> bArchivesOk = true;
+        {
+            TaskManager<PackArchiveTask> stPackManager(std::max<size_t>(1, std::min(m_stPackOptions.nConcurrency, vArchives.size())),
+                [&](const PackArchiveTask& stArchive, const std::atomic<bool>& bStopFlag) {
+                std::string sData;
+                for (const auto& sName : stArchive.vMembers) {
+                    const PackMember* pMember = stIndex.find(sName);
+                    std::ifstream fsIn(sLocalPath + "/" + sName, std::ios::binary);
+                    size_t nStart = sData.size();
+                    sData.resize(nStart + pMember->nLength);
+                    // the file changed since the scan, the index would be wrong
+                    if (!fsIn.read(sData.data() + nStart, pMember->nLength) || fsIn.peek() != EOF || pMember->nOffset != nStart) {
+                        spdlog::get("MinIOManager")->critical("Pack [{}] failed: {} changed while packing", sObject, sName);
+                        bArchivesOk = false;
+                        return false;
+                    }
+                }
+                if (bStopFlag || !putBuffer(sBucket, sObject + "/" + PackIndex::archiveName(stArchive.nArchive), sData)) {
+                    bArchivesOk = false;
+                    return false;
+                }
+                return true;
+            });
+            stPackManager.addTasks(vArchives);
+            stPackManager.start();
+            stPackManager.waitForComplete();
+        }
+
+        stDownUpManager.waitForComplete();
+        bool bFilesOk = stDownUpManager.takeFailedTasks().empty();
+        // the index goes last, readers never see members of missing archives
+        bool bIndexOk = bArchivesOk && putBuffer(sBucket, sObject + "/" + PackIndex::indexName(), stIndex.serialize());
+        std::cout << "Packed " << vSmall.size() << " files into " << vArchives.size() << " archives" << std::endl;
+        if (!bScanned || !bFilesOk || !bIndexOk) return EXIT_FAILURE;
+    } catch (const std::exception &e) {
+        spdlog::get("MinIOManager")->critical("upload exception: {}", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+bool MinIOManager::loadPackIndex(const std::string& sBucket, const std::string& sObject, PackIndex& stIndex) {
+    std::string sData;
+    if (!downloadToBuffer(sBucket, sObject + "/" + PackIndex::indexName(), sData)) return false;
+    if (!stIndex.parse(sData)) {
+        spdlog::get("MinIOManager")->critical("Pack index [{}] is corrupt", sObject);
+        return false;
+    }
+    return true;
+}
+
+bool MinIOManager::readPackedFile(const std::string& sBucket, const std::string& sObject, const PackIndex& stIndex,
+                        const std::string& sName, std::string& sData) {
+    const PackMember* pMember = stIndex.find(sName);
+    if (pMember == nullptr) return false;
+    sData.clear();
+    if (pMember->nLength == 0) return true;
+    sData.reserve(pMember->nLength);
+    try {
+        size_t nOffset = pMember->nOffset;
+        size_t nLength = pMember->nLength;
+        minio::s3::GetObjectArgs args;
+        args.bucket = sBucket;
+        args.object = sObject + "/" + PackIndex::archiveName(pMember->nArchive);
+        args.offset = &nOffset;
+        args.length = &nLength;
+        args.datafunc = [&](minio::http::DataFunctionArgs stArgs) -> bool {
+            throttle(stArgs.datachunk.size());
+            sData.append(stArgs.datachunk.data(), stArgs.datachunk.size());
+            return true;
+        };
+        auto response = client().GetObject(args);
+        if (!response || sData.size() != pMember->nLength) {
+            spdlog::get("MinIOManager")->critical("Read packed [{}] failed: {}", sName, response.Error().String());
+            return false;
+        }
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Download Exception: {}", e.what());
+        return false;
+    }
+    return true;
+}
+
+int MinIOManager::downloadDirectoryPacked(const std::string& sBucket,
+                        const std::string& sObject,
+                        const std::string& sLocalPath) {
+    PackIndex stIndex;
+    if (!loadPackIndex(sBucket, sObject, stIndex)) return EXIT_FAILURE;
+    try {
+        // the unpacked large files download meanwhile
+        ObjectFilter stFilter;
+        std::string sPackPrefix = sObject + "/" + PackIndex::kPackDir;
+        stFilter.funMatch = [&sPackPrefix](const minio::s3::Item& item) { return item.name.compare(0, sPackPrefix.size(), sPackPrefix) != 0; };
+        stDownUpManager.takeFailedTasks();
+        stDownUpManager.beginFeed();
+        stDownUpManager.start();
+        bool bListed = listObjectsPaged(sBucket, sObject + "/", stFilter, [&](std::vector<minio::s3::Item>& vPage) {
+            std::vector<MinioTask> vTasks;
+            for (const auto& item : vPage) {
+                MinioTask stTask(sBucket, item.name, sLocalPath + "/" + item.name.substr(sObject.length() + 1), false, item.size);
+                stTask.sEtag = item.etag;
+                vTasks.push_back(std::move(stTask));
+            }
+            for (auto& stTask : vTasks) prioritize(stTask);
+            stDownUpManager.addTasks(vTasks);
+            return true;
+        }, 256);
+        stDownUpManager.endFeed();
+
+        std::atomic<bool> bArchivesOk = true;
+        {
+            std::vector<PackArchiveTask> vArchives(stIndex.archiveCount());
+            for (uint32_t i = 0; i < stIndex.archiveCount(); ++i) vArchives[i].nArchive = i;
+            TaskManager<PackArchiveTask> stPackManager(std::max<size_t>(1, std::min<size_t>(m_stPackOptions.nConcurrency, vArchives.size())),
+                [&](const PackArchiveTask& stArchive, const std::atomic<bool>& bStopFlag) {
+                auto vMembers = stIndex.archiveMembers(stArchive.nArchive);
+                size_t nMember = 0;
+                size_t nPos = 0;
+                std::ofstream fsOut;
+                bool bWriteOk = true;
+                // open members as the stream reaches them, empty ones included; runs inside the datafunc, no throwing
+                auto funNextMember = [&]() {
+                    while (bWriteOk && nMember < vMembers.size() && !fsOut.is_open()) {
+                        std::filesystem::path fsPath(sLocalPath + "/" + vMembers[nMember].first);
+                        std::error_code ec;
+                        std::filesystem::create_directories(fsPath.parent_path(), ec);
+                        fsOut.open(fsPath, std::ios::binary | std::ios::trunc);
+                        if (!fsOut.is_open()) {
+                            spdlog::get("MinIOManager")->critical("Unpack [{}] failed: open {} {}", 
+                                vMembers[nMember].first, fsPath.string(), ec.message());
+                            bWriteOk = false;
+                            break;
+                        }
+                        if (vMembers[nMember].second.nLength == 0) {
+                            fsOut.close();
+                            ++nMember;
+                        }
+                    }
+                    return bWriteOk;
+                };
+                minio::s3::GetObjectArgs args;
+                args.bucket = sBucket;
+                args.object = sObject + "/" + PackIndex::archiveName(stArchive.nArchive);
+                if (!funNextMember()) {
+                    bArchivesOk = false;
+                    return false;
+                }
+                args.datafunc = [&](minio::http::DataFunctionArgs stArgs) -> bool {
+                    throttle(stArgs.datachunk.size());
+                    std::string_view sChunk = stArgs.datachunk;
+                    while (bWriteOk && !sChunk.empty() && nMember < vMembers.size()) {
+                        const PackMember& stMember = vMembers[nMember].second;
+                        size_t nTake = std::min(sChunk.size(), stMember.nOffset + stMember.nLength - nPos);
+                        fsOut.write(sChunk.data(), nTake);
+                        sChunk.remove_prefix(nTake);
+                        nPos += nTake;
+                        if (nPos == stMember.nOffset + stMember.nLength) {
+                            fsOut.close();
+                            bWriteOk = bWriteOk && !fsOut.fail();
+                            ++nMember;
+                            funNextMember();
+                        }
+                    }
+                    return bWriteOk && !bStopFlag;
+                };
+                auto response = client().GetObject(args);
+                if (!response || !bWriteOk || nMember != vMembers.size()) {
+                    spdlog::get("MinIOManager")->critical("Unpack [{}] failed: {}", args.object, 
+                        (!bWriteOk ? std::string("write to ") + sLocalPath 
+                        : (!response ? response.Error().String() 
+                        : "archive ended at member " + std::to_string(nMember) + " of " + std::to_string(vMembers.size()))));
+                    bArchivesOk = false;
+                    return false;
+                }
+                return true;
+            });
+            stPackManager.addTasks(vArchives);
+            stPackManager.start();
+            stPackManager.waitForComplete();
+        }
+
+        stDownUpManager.waitForComplete();
+        std::cout << "Unpacked " << stIndex.size() << " files from " << stIndex.archiveCount() << " archives" << std::endl;
+        if (!bListed || !bArchivesOk || !stDownUpManager.takeFailedTasks().empty()) return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Download Exception: {}", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+std::string MinIOManager::createMultipart(const std::string& sBucket, const std::string& sObject, const std::string& sLabel,
+                        const std::string& sCrc32c, const std::string& sCodec) {
+    try {
+        minio::s3::CreateMultipartUploadArgs stCreateArgs;
+        stCreateArgs.bucket = sBucket;
+        stCreateArgs.object = sObject;
+        if (!sCodec.empty()) {
+            stCreateArgs.headers.Add("x-amz-meta-codec", sCodec);
+            stCreateArgs.headers.Add("Content-Encoding", sCodec);
+        }
+        if (!sCrc32c.empty()) stCreateArgs.headers.Add("x-amz-meta-crc32c", sCrc32c);
+        auto stCreateRes = client().CreateMultipartUpload(stCreateArgs);
+        if (stCreateRes) return stCreateRes.upload_id;
+        spdlog::get("MinIOManager")->critical("Upload [{}] create multipart failed: {}", sLabel, stCreateRes.Error().String());
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Upload Exception: {}", e.what());
+    }
+    return "";
+}
+
+bool MinIOManager::uploadPart(const std::string& sBucket, const std::string& sObject, const std::string& sUploadId,
+                        unsigned int nPartNumber, std::string_view sData, const std::atomic<bool>& bStopFlag,
+                        const std::string& sLabel, std::string& sEtag, std::atomic<bool>& bNoSuchUpload) {
+    for (int nTry = 0; nTry <= m_stMultipartOptions.nPartRetries && !bStopFlag; ++nTry) {
+        if (nTry > 0) m_stMetrics.addRetry(sBucket);
+        try {
+            minio::s3::UploadPartArgs stPartArgs;
+            stPartArgs.bucket = sBucket;
+            stPartArgs.object = sObject;
+            stPartArgs.upload_id = sUploadId;
+            stPartArgs.part_number = nPartNumber;
+            stPartArgs.data = sData;
+            throttle(sData.size());
+            auto stPartRes = client().UploadPart(stPartArgs);
+            if (stPartRes) {
+                sEtag = stPartRes.etag;
+                return true;
+            }
+            if (stPartRes.code == "NoSuchUpload") {
+                bNoSuchUpload = true;
+                return false;
+            }
+            spdlog::get("MinIOManager")->warn("Upload [{}] part {} try {} failed: {}", sLabel, nPartNumber, nTry, stPartRes.Error().String());
+        } catch (const std::exception& e) {
+            spdlog::get("MinIOManager")->warn("Upload [{}] part {} try {} exception: {}", sLabel, nPartNumber, nTry, e.what());
+        }
+    }
+    return false;
+}
+
+bool MinIOManager::completeMultipart(const std::string& sBucket, const std::string& sObject, const std::string& sUploadId,
+                        const std::vector<std::string>& vEtags, const std::string& sLabel, std::atomic<bool>& bNoSuchUpload) {
+    bool bAllParts = std::all_of(vEtags.begin(), vEtags.end(), [](const std::string& sEtag) { return !sEtag.empty(); });
+    if (!bAllParts) {
+        spdlog::get("MinIOManager")->critical("Upload [{}] failed: not all of {} parts uploaded", sLabel, vEtags.size());
+        return false;
+    }
+    try {
+        minio::s3::CompleteMultipartUploadArgs stCompleteArgs;
+        stCompleteArgs.bucket = sBucket;
+        stCompleteArgs.object = sObject;
+        stCompleteArgs.upload_id = sUploadId;
+        for (size_t i = 0; i < vEtags.size(); ++i) {
+            minio::s3::Part stPart;
+            stPart.number = i + 1;
+            stPart.etag = vEtags[i];
+            stCompleteArgs.parts.push_back(stPart);
+        }
+        auto stCompleteRes = client().CompleteMultipartUpload(stCompleteArgs);
+        if (stCompleteRes) {
+            m_stMetaCache.invalidateObject(sBucket, sObject);
+            return true;
+        }
+        if (stCompleteRes.code == "NoSuchUpload") bNoSuchUpload = true;
+        spdlog::get("MinIOManager")->critical("Upload [{}] complete multipart failed: {}", sLabel, stCompleteRes.Error().String());
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Upload Exception: {}", e.what());
+    }
+    return false;
+}
+
+void MinIOManager::abortMultipart(const std::string& sBucket, const std::string& sObject, const std::string& sUploadId) {
+    try {
+        minio::s3::AbortMultipartUploadArgs stAbortArgs;
+        stAbortArgs.bucket = sBucket;
+        stAbortArgs.object = sObject;
+        stAbortArgs.upload_id = sUploadId;
+        client().AbortMultipartUpload(stAbortArgs);
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->warn("Abort upload {} exception: {}", sUploadId, e.what());
+    }
+}
+
+bool MinIOManager::uploadBuffer(const std::string& sBucket, const std::string& sObject, std::string_view sData) {
+    if (!bucketExists(sBucket) && !makeBucket(sBucket)) return false;
+    if (sData.size() < std::max<size_t>(m_stMultipartOptions.nThreshold, 5ull << 20)) {
+        return putBuffer(sBucket, sObject, sData);
+    }
+
+    size_t nPartSize = std::max<size_t>(m_stMultipartOptions.nPartSize, 5ull << 20);
+    nPartSize = std::max<size_t>(nPartSize, (sData.size() + 9999) / 10000);
+    size_t nNumParts = (sData.size() + nPartSize - 1) / nPartSize;
+    std::string sUploadId = createMultipart(sBucket, sObject, sObject, 
+        (m_stVerifyOptions.bEnabled ? Crc32c::toHex(Crc32c::extend(0, sData.data(), sData.size())) : ""));
+    if (sUploadId.empty()) return false;
+
+    std::vector<std::string> vEtags(nNumParts);
+    std::atomic<bool> bNoSuchUpload = false;
+    {
+        TaskManager<MinioPartTask> stPartManager(std::max<size_t>(1, std::min(m_stMultipartOptions.nPartConcurrency, nNumParts)), 
+            [&](const MinioPartTask& stPart, const std::atomic<bool>& bStopFlag) {
+            return uploadPart(sBucket, sObject, sUploadId, stPart.nPartNumber, sData.substr(stPart.nOffset, stPart.nLength), 
+                        bStopFlag, sObject, vEtags[stPart.nPartNumber - 1], bNoSuchUpload);
+        });
+        for (size_t i = 0; i < nNumParts; ++i) {
+            MinioPartTask stPart;
+            stPart.nPartNumber = i + 1;
+            stPart.nOffset = i * nPartSize;
+            stPart.nLength = std::min(nPartSize, sData.size() - stPart.nOffset);
+            stPartManager.addTask(stPart);
+        }
+        stPartManager.start();
+        stPartManager.waitForComplete();
+    }
+    if (completeMultipart(sBucket, sObject, sUploadId, vEtags, sObject, bNoSuchUpload)) return true;
+    abortMultipart(sBucket, sObject, sUploadId);
+    return false;
+}
+
+bool MinIOManager::uploadBuffer(const std::string& sBucket, const std::string& sObject, const std::vector<uint8_t>& vData) {
+    return uploadBuffer(sBucket, sObject, std::string_view(reinterpret_cast<const char*>(vData.data()), vData.size()));
+}
+
+bool MinIOManager::uploadStream(const std::string& sBucket, const std::string& sObject, 
+                        const std::function<bool(const std::function<bool(std::string_view)>&)>& funProducer,
+                        const std::string& sCodec) {
+    if (!bucketExists(sBucket) && !makeBucket(sBucket)) return false;
+    // the producer size is unknown, the part size must keep 10000 parts enough for the expected output
+    size_t nPartSize = std::max<size_t>(m_stMultipartOptions.nPartSize, 5ull << 20);
+    size_t nMaxInFlight = std::max<size_t>(1, m_stMultipartOptions.nPartConcurrency);
+
+    std::string sUploadId;
+    std::vector<std::string> vEtags;
+    std::atomic<bool> bNoSuchUpload = false;
+    std::atomic<bool> bPartFailed = false;
+    std::mutex mutexParts;
+    std::condition_variable cvParts;
+    size_t nInFlight = 0;
+    TaskManager<StreamPartTask> stPartManager(nMaxInFlight, [&](const StreamPartTask& stPart, const std::atomic<bool>& bStopFlag) {
+        std::string sEtag;
+        bool bRes = uploadPart(sBucket, sObject, sUploadId, stPart.nPartNumber, *stPart.pData, bStopFlag, sObject, sEtag, bNoSuchUpload);
+        std::lock_guard<std::mutex> lock(mutexParts);
+        vEtags[stPart.nPartNumber - 1] = sEtag;
+        if (!bRes) bPartFailed = true;
+        --nInFlight;
+        cvParts.notify_all();
+        return bRes;
+    });
+
+    auto pPart = std::make_shared<std::string>();
+    pPart->reserve(nPartSize);
+    bool bStarted = false;
+    // hand a full part to the uploaders, waits while nMaxInFlight parts are pending so memory stays bounded
+    auto funFlush = [&]() {
+        if (!bStarted) {
+            sUploadId = createMultipart(sBucket, sObject, sObject, "", sCodec);
+            if (sUploadId.empty()) return false;
+            stPartManager.beginFeed();
+            stPartManager.start();
+            bStarted = true;
+        }
+        std::unique_lock<std::mutex> lock(mutexParts);
+        cvParts.wait(lock, [&] { return nInFlight < nMaxInFlight; });
+        if (bPartFailed) return false;
+        ++nInFlight;
+        vEtags.push_back("");
+        StreamPartTask stPart;
+        stPart.nPartNumber = static_cast<unsigned int>(vEtags.size());
+        stPart.pData = std::move(pPart);
+        lock.unlock();
+        stPartManager.addTask(stPart);
+        pPart = std::make_shared<std::string>();
+        pPart->reserve(nPartSize);
+        return true;
+    };
+
+    bool bProduced = funProducer([&](std::string_view sChunk) {
+        while (!sChunk.empty()) {
+            size_t nTake = std::min(sChunk.size(), nPartSize - pPart->size());
+            pPart->append(sChunk.data(), nTake);
+            sChunk.remove_prefix(nTake);
+            if (pPart->size() == nPartSize && !funFlush()) return false;
+        }
+        return true;
+    });
+
+    // everything fit into one part, a single put is cheaper
+    if (!bStarted) {
+        return bProduced && putBuffer(sBucket, sObject, *pPart, sCodec);
+    }
+    bool bRes = bProduced && (pPart->empty() || funFlush());
+    stPartManager.endFeed();
+    stPartManager.waitForComplete();
+    bRes = bRes && completeMultipart(sBucket, sObject, sUploadId, vEtags, sObject, bNoSuchUpload);
+    if (!bRes) abortMultipart(sBucket, sObject, sUploadId);
+    return bRes;
+}
+
+void MinIOManager::setCheckpointOptions(const CheckpointOptions& stOptions) {
+    m_stCheckpointOptions = stOptions;
+}
+
+void MinIOManager::abortCheckpointedUpload(const std::string& sCheckpointPath) {
+    // "multipart <size> <mtime> <part size> <bucket>/<object>" then the upload id
+    auto vHead = TransferCheckpoint::readHead(sCheckpointPath, 2);
+    if (vHead.size() < 2 || vHead[0].rfind("multipart ", 0) != 0) return;
+    size_t nPos = 0;
+    for (int i = 0; i < 4 && nPos != std::string::npos; ++i) nPos = vHead[0].find(' ', nPos + 1);
+    if (nPos == std::string::npos) return;
+    std::string sTarget = vHead[0].substr(nPos + 1);
+    size_t nSlash = sTarget.find('/');
+    if (nSlash == std::string::npos) return;
+    try {
+        minio::s3::AbortMultipartUploadArgs stAbortArgs;
+        stAbortArgs.bucket = sTarget.substr(0, nSlash);
+        stAbortArgs.object = sTarget.substr(nSlash + 1);
+        stAbortArgs.upload_id = vHead[1];
+        client().AbortMultipartUpload(stAbortArgs);
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->warn("Abort checkpointed upload {} exception: {}", vHead[1], e.what());
+    }
+}
+
+std::filesystem::path MinIOManager::checkpointDir() const {
+    return (m_stCheckpointOptions.sDir.empty() ? 
+        std::filesystem::temp_directory_path() / "minio_checkpoints" : std::filesystem::path(m_stCheckpointOptions.sDir));
+}
+
+std::string MinIOManager::checkpointPath(const std::string& sLocalPathName, const char* szKind) const {
+    std::filesystem::path fsDir = checkpointDir();
+    std::error_code ec;
+    std::filesystem::create_directories(fsDir, ec);
+    // the name for reading, the hash of the absolute path for uniqueness
+    std::filesystem::path fsLocal = std::filesystem::absolute(sLocalPathName, ec);
+    char szHash[17];
+    std::snprintf(szHash, sizeof(szHash), "%016zx", std::hash<std::string>{}(fsLocal.string()));
+    return (fsDir / (fsLocal.filename().string() + "." + szHash + "." + szKind + ".ckpt")).string();
+}
+
+bool MinIOManager::isPartialFile(const std::string& sName) {
+    for (const char* szSuffix : {".ranged", ".ckpt", ".inflate", ".verify"}) {
+        size_t nLen = std::strlen(szSuffix);
+        if (sName.size() > nLen && sName.compare(sName.size() - nLen, nLen, szSuffix) == 0) return true;
+    }
+    return false;
+}
+
+int MinIOManager::cleanupCheckpoints() {
+    std::vector<std::string> vStale;
+    std::error_code ec;
+    for (auto itr = std::filesystem::directory_iterator(checkpointDir(), ec); !ec && itr != std::filesystem::directory_iterator(); itr.increment(ec)) {
+        std::string sPath = itr->path().string();
+        if (itr->path().extension() != ".ckpt") continue;
+        if (!TransferCheckpoint::isStale(sPath, m_stCheckpointOptions.nStaleSeconds)) continue;
+        vStale.push_back(sPath);
+    }
+    for (const auto& sPath : vStale) {
+        // "ranged <etag> <size> <range size> <partial file>"
+        auto vHead = TransferCheckpoint::readHead(sPath, 1);
+        if (!vHead.empty() && vHead[0].rfind("ranged ", 0) == 0) {
+            size_t nPos = 0;
+            for (int i = 0; i < 4 && nPos != std::string::npos; ++i) nPos = vHead[0].find(' ', nPos + 1);
+            if (nPos != std::string::npos) std::filesystem::remove(vHead[0].substr(nPos + 1), ec);
+        } else {
+            abortCheckpointedUpload(sPath);
+        }
+        std::filesystem::remove(sPath, ec);
+    }
+    return static_cast<int>(vStale.size());
+}
+
+bool MinIOManager::downloadStream(const std::string& sBucket, 
+                    const std::string& sObject,
+                    const std::function<bool(std::string_view)>& funOnData) {
+    try {
+        bool bStopped = false;
+        minio::s3::GetObjectArgs args;
+        args.bucket = sBucket;
+        args.object = sObject;
+        args.datafunc = [&](minio::http::DataFunctionArgs stArgs) -> bool {
+            throttle(stArgs.datachunk.size());
+            if (funOnData(stArgs.datachunk)) return true;
+            bStopped = true;
+            return false;
+        };
+        auto response = client().GetObject(args);
+        if (!response && !bStopped) {
+            spdlog::get("MinIOManager")->critical("Download [{}] failed: {}", sObject, response.Error().String());
+            return false;
+        }
+        return !bStopped;
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Download Exception: {}", e.what());
+    }
+    return false;
+}
+
+template <typename Buffer>
+static bool downloadIntoBuffer(MinIOManager& stManager, const std::string& sBucket, const std::string& sObject, Buffer& stBuffer, size_t nPadding) {
+    stBuffer.clear();
+    bool bRes = stManager.downloadStream(sBucket, sObject, [&](std::string_view sChunk) {
+        stBuffer.insert(stBuffer.end(), sChunk.begin(), sChunk.end());
+        return true;
+    });
+    if (bRes && nPadding > 0) {
+        // zero the padding then shrink size back, the capacity keeps it
+        size_t nSize = stBuffer.size();
+        stBuffer.resize(nSize + nPadding, 0);
+        stBuffer.resize(nSize);
+    }
+    return bRes;
+}
+
+bool MinIOManager::downloadToBuffer(const std::string& sBucket, const std::string& sObject, std::string& sBuffer, size_t nPadding) {
+    return downloadIntoBuffer(*this, sBucket, sObject, sBuffer, nPadding);
+}
+
+bool MinIOManager::downloadToBuffer(const std::string& sBucket, const std::string& sObject, std::vector<uint8_t>& vBuffer, size_t nPadding) {
+    return downloadIntoBuffer(*this, sBucket, sObject, vBuffer, nPadding);
+}
+
+void MinIOManager::setRangedDownloadOptions(const RangedDownloadOptions& stOptions) {
+    m_stRangedOptions = stOptions;
+}
+
+bool MinIOManager::downloadObjectRanged(const std::string& sBucket, 
+                    const std::string& sObject,
+                    const std::string& sSavePath,
+                    const std::string& sEtag) {
+    for (int nTry = 0; ; ++nTry) {
+        bool bMismatch = false;
+        if (downloadRangedOnce(sBucket, sObject, sSavePath, sEtag, bMismatch)) return true;
+        if (!bMismatch || nTry >= m_stVerifyOptions.nRetries) return false;
+        m_stMetrics.addRetry(sBucket);
+        spdlog::get("MinIOManager")->warn("Download [{}] checksum mismatch, try {} again", sObject, nTry + 1);
+    }
+}
+
+bool MinIOManager::downloadRangedOnce(const std::string& sBucket, const std::string& sObject, 
+                    const std::string& sSavePath, const std::string& sExpectEtag, bool& bMismatch) {
+    // always ask the server, the ranges are pinned to this version
+    ObjectMeta stMeta;
+    if (!statObject(sBucket, sObject, stMeta, false)) return false;
+    std::string sEtag = stMeta.sEtag;
+    if (!sExpectEtag.empty() && sEtag != sExpectEtag) {
+        spdlog::get("MinIOManager")->warn("Download [{}] failed: etag {} is no longer {}", sObject, sEtag, sExpectEtag);
+        return false;
+    }
+    size_t nObjectSize = stMeta.nSize;
+
+    std::filesystem::path fsPath(sSavePath);
+    if (fsPath.has_parent_path() && !std::filesystem::exists(fsPath.parent_path()))
+        std::filesystem::create_directories(fsPath.parent_path());
+    // write beside the target and rename once complete, the target never holds a partial file
+    std::string sTmpPath = sSavePath + ".ranged";
+    size_t nRangeSize = std::max<size_t>(m_stRangedOptions.nRangeSize, 1ull << 20);
+    size_t nNumRanges = (nObjectSize + nRangeSize - 1) / nRangeSize;
+    std::vector<char> vDone(nNumRanges, 0);
+    // crc32c of each range as it arrives, combined in order at the end
+    bool bVerify = m_stVerifyOptions.bEnabled && !stMeta.sCrc32c.empty();
+    std::vector<uint32_t> vRangeCrc(nNumRanges, 0);
+    std::vector<char> vFromDisk(nNumRanges, 0);
+
+    // completed range indexes of this object version, the partial file is kept with them
+    bool bCheckpoint = m_stCheckpointOptions.bEnabled;
+    TransferCheckpoint stCheckpoint(bCheckpoint ? checkpointPath(sSavePath, "ranged") : "");
+    // the partial file goes last, cleanupCheckpoints removes it with a stale checkpoint
+    std::string sHeader = "ranged " + sEtag + " " + std::to_string(nObjectSize) + " " + std::to_string(nRangeSize) + " " + sTmpPath;
+    std::vector<std::string> vLines;
+    std::error_code ec;
+    bool bResumed = bCheckpoint && stCheckpoint.load(sHeader, vLines, m_stCheckpointOptions.nStaleSeconds)
+                    && std::filesystem::file_size(sTmpPath, ec) == nObjectSize && !ec && stCheckpoint.resume();
+    int nFd = -1;
+    if (bResumed) {
+        for (const auto& sLine : vLines) {
+            size_t nIndex = std::strtoull(sLine.c_str(), nullptr, 10);
+            if (nIndex < nNumRanges) vDone[nIndex] = 1;
+        }
+        vFromDisk = vDone;
+        nFd = open(sTmpPath.c_str(), O_WRONLY);
+        spdlog::get("MinIOManager")->info("Download [{}] resumes with {}/{} ranges done", sObject, 
+            std::count(vDone.begin(), vDone.end(), 1), nNumRanges);
+    } else {
+        if (bCheckpoint) stCheckpoint.begin(sHeader);
+        nFd = open(sTmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (nFd < 0) {
+        spdlog::get("MinIOManager")->critical("Download [{}] failed: open {} {}", sObject, sTmpPath, std::strerror(errno));
+        stCheckpoint.remove();
+        return false;
+    }
+    if (!bResumed && nObjectSize > 0 && posix_fallocate(nFd, 0, nObjectSize) != 0 && ftruncate(nFd, nObjectSize) != 0) {
+        spdlog::get("MinIOManager")->critical("Download [{}] failed: preallocate {} bytes", sObject, nObjectSize);
+        close(nFd);
+        std::filesystem::remove(sTmpPath);
+        stCheckpoint.remove();
+        return false;
+    }
+
+    {
+        TaskManager<MinioPartTask> stRangeManager(std::max<size_t>(1, std::min(m_stRangedOptions.nConcurrency, nNumRanges)), 
+            [&](const MinioPartTask& stRange, const std::atomic<bool>& bStopFlag) {
+            for (int nTry = 0; nTry <= m_stRangedOptions.nRangeRetries && !bStopFlag; ++nTry) {
+                if (nTry > 0) m_stMetrics.addRetry(sBucket);
+                size_t nWritten = 0;
+                uint32_t nCrc = 0;
+                bool bWriteOk = true;
+                try {
+                    size_t nOffset = stRange.nOffset;
+                    size_t nLength = stRange.nLength;
+                    minio::s3::GetObjectArgs stGetArgs;
+                    stGetArgs.bucket = sBucket;
+                    stGetArgs.object = sObject;
+                    stGetArgs.offset = &nOffset;
+                    stGetArgs.length = &nLength;
+                    // every range must come from the same object version
+                    stGetArgs.match_etag = sEtag;
+                    stGetArgs.datafunc = [&](minio::http::DataFunctionArgs args) -> bool {
+                        const char* pChunk = args.datachunk.data();
+                        size_t nChunk = args.datachunk.size();
+                        throttle(nChunk);
+                        if (bVerify) nCrc = Crc32c::extend(nCrc, pChunk, nChunk);
+                        while (nChunk > 0) {
+                            ssize_t nRet = pwrite(nFd, pChunk, nChunk, stRange.nOffset + nWritten);
+                            if (nRet < 0) {
+                                if (errno == EINTR) continue;
+                                bWriteOk = false;
+                                return false;
+                            }
+                            pChunk += nRet;
+                            nChunk -= nRet;
+                            nWritten += nRet;
+                        }
+                        return !bStopFlag;
+                    };
+                    auto stGetRes = client().GetObject(stGetArgs);
+                    if (stGetRes && bWriteOk && nWritten == stRange.nLength) {
+                        vRangeCrc[stRange.nPartNumber] = nCrc;
+                        vDone[stRange.nPartNumber] = 1;
+                        if (bCheckpoint) stCheckpoint.append(std::to_string(stRange.nPartNumber));
+                        return true;
+                    }
+                    spdlog::get("MinIOManager")->warn("Download [{}] range {} try {} failed: {} ({}/{} bytes)", 
+                            sObject, stRange.nPartNumber, nTry, stGetRes.Error().String(), nWritten, stRange.nLength);
+                } catch (const std::exception& e) {
+                    spdlog::get("MinIOManager")->warn("Download [{}] range {} try {} exception: {}", sObject, stRange.nPartNumber, nTry, e.what());
+                }
+            }
+            return false;
+        });
+        for (size_t i = 0; i < nNumRanges; ++i) {
+            if (vDone[i]) continue;
+            MinioPartTask stRange;
+            stRange.nPartNumber = i;
+            stRange.nOffset = i * nRangeSize;
+            stRange.nLength = std::min(nRangeSize, nObjectSize - stRange.nOffset);
+            stRangeManager.addTask(stRange);
+        }
+        stRangeManager.start();
+        stRangeManager.waitForComplete();
+    }
+
+    struct stat stStat;
+    bool bRes = std::all_of(vDone.begin(), vDone.end(), [](char c) { return c != 0; })
+                && fstat(nFd, &stStat) == 0 && static_cast<size_t>(stStat.st_size) == nObjectSize;
+    if (bRes && bVerify) {
+        uint32_t nCrc = 0;
+        std::vector<char> vBuffer;
+        int nReadFd = (bResumed ? open(sTmpPath.c_str(), O_RDONLY) : -1);
+        for (size_t i = 0; bRes && i < nNumRanges; ++i) {
+            size_t nOffset = i * nRangeSize;
+            size_t nLength = std::min(nRangeSize, nObjectSize - nOffset);
+            // ranges of a resumed download were written by an earlier run, hash them from disk
+            if (vFromDisk[i]) {
+                vBuffer.resize(nLength);
+                bRes = (nReadFd >= 0 && pread(nReadFd, vBuffer.data(), nLength, nOffset) == static_cast<ssize_t>(nLength));
+                vRangeCrc[i] = Crc32c::extend(0, vBuffer.data(), nLength);
+            }
+            nCrc = Crc32c::combine(nCrc, vRangeCrc[i], nLength);
+        }
+        if (nReadFd >= 0) close(nReadFd);
+        if (bRes && Crc32c::toHex(nCrc) != stMeta.sCrc32c) {
+            spdlog::get("MinIOManager")->warn("Download [{}] crc32c {} != {}", sObject, Crc32c::toHex(nCrc), stMeta.sCrc32c);
+            close(nFd);
+            // the partial file holds bad bytes, never resume from it
+            std::filesystem::remove(sTmpPath);
+            stCheckpoint.remove();
+            bMismatch = true;
+            return false;
+        }
+    }
+    close(nFd);
+    if (!bRes) {
+        spdlog::get("MinIOManager")->critical("Download [{}] failed: {} ranges of {} bytes incomplete", sObject, nNumRanges, nObjectSize);
+        // the checkpoint keeps the partial file for the next attempt
+        if (!bCheckpoint) std::filesystem::remove(sTmpPath);
+        return false;
+    }
+    std::filesystem::rename(sTmpPath, sSavePath);
+    stCheckpoint.remove();
+    return true;
+}
+
+bool MinIOManager::statObject(const std::string& sBucket, const std::string& sObject, ObjectMeta& stMeta, bool bUseCache) {
+    if (bUseCache && m_stMetaCache.stat(sBucket, sObject, stMeta)) return true;
+    MetaTimer stTimer(m_stMetrics, sBucket);
+    try {
+        minio::s3::StatObjectArgs stStatArgs;
+        stStatArgs.bucket = sBucket;
+        stStatArgs.object = sObject;
+        auto stStat = client().StatObject(stStatArgs);
+        if (!stStat) {
+            m_stMetaCache.invalidateObject(sBucket, sObject);
+            spdlog::get("MinIOManager")->critical("Stat [{}] failed: {}", sObject, stStat.Error().String());
+            return false;
+        }
+        stMeta.nSize = stStat.size;
+        stMeta.sEtag = stStat.etag;
+        auto lsCodec = stStat.user_metadata.Get("codec");
+        stMeta.sCodec = (lsCodec.empty() ? "" : lsCodec.front());
+        auto lsCrc32c = stStat.user_metadata.Get("crc32c");
+        stMeta.sCrc32c = (lsCrc32c.empty() ? "" : lsCrc32c.front());
+        stMeta.bEncrypted = !stStat.headers.Get("x-amz-server-side-encryption").empty()
+                        || !stStat.headers.Get("x-amz-server-side-encryption-customer-algorithm").empty();
+        m_stMetaCache.putStat(sBucket, sObject, stMeta);
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Stat Exception: {}", e.what());
+        return false;
+    }
+    return true;
+}
+
+void MinIOManager::setMetadataCacheTtl(std::chrono::milliseconds stTtl) {
+    m_stMetaCache.setTtl(stTtl);
+}
+
+void MinIOManager::invalidateMetadata(const std::string& sBucket, const std::string& sObject) {
+    if (sObject.empty()) m_stMetaCache.invalidateBucket(sBucket);
+    else m_stMetaCache.invalidateObject(sBucket, sObject);
+}
+
+void MinIOManager::enableObjectCache(const std::string& sCacheDir, size_t nMaxBytes, bool bLinkTargets) {
+    // prefetch checks the cache under the same lock, its workers are joined before the swap
+    std::lock_guard<std::mutex> lock(m_mutexPrefetch);
+    m_pPrefetchManager.reset();
+    m_pObjectCache = std::make_unique<ObjectCache>(sCacheDir, nMaxBytes, bLinkTargets);
+}
+
+void MinIOManager::disableObjectCache() {
+    std::lock_guard<std::mutex> lock(m_mutexPrefetch);
+    m_pPrefetchManager.reset();
+    m_pObjectCache.reset();
+}
+
+void MinIOManager::setTransferThreads(size_t nThreads) {
+    stDownUpManager.setThreadCount(std::max<size_t>(nThreads, 1));
+}
+
+void MinIOManager::setPrefetchThreads(size_t nThreads) {
+    std::lock_guard<std::mutex> lock(m_mutexPrefetch);
+    m_nPrefetchThreads = std::max<size_t>(nThreads, 1);
+}
+
+void MinIOManager::prefetch(const std::string& sBucket, const std::vector<std::string>& vObjects, int nPriority) {
+    std::lock_guard<std::mutex> lock(m_mutexPrefetch);
+    if (!m_pObjectCache) {
+        spdlog::get("MinIOManager")->warn("Prefetch ignored, the object cache is disabled");
+        return;
+    }
+    if (!m_pPrefetchManager) {
+        m_pPrefetchManager = std::make_unique<TaskManager<MinioTask> >(m_nPrefetchThreads, 
+            [this](const MinioTask& stTask, const std::atomic<bool>& bStopFlag) {
+            return prefetchTask(stTask, bStopFlag);
+        });
+        // never completes, the workers wait for more until the cache is disabled or replaced
+        m_pPrefetchManager->beginFeed();
+        m_pPrefetchManager->start();
+    }
+    std::vector<MinioTask> vTasks;
+    vTasks.reserve(vObjects.size());
+    for (const auto& sObject : vObjects) {
+        MinioTask stTask(sBucket, sObject, "");
+        stTask.nPriority = nPriority;
+        vTasks.push_back(std::move(stTask));
+    }
+    m_pPrefetchManager->addTasks(vTasks);
+}
+
+bool MinIOManager::prefetchTask(const MinioTask& stTask, const std::atomic<bool>& bStopFlag) {
+    if (bStopFlag) return false;
+    ObjectMeta stMeta;
+    if (!statObject(stTask.sBucket, stTask.sObjectKey, stMeta)) return false;
+    // stored compressed objects are inflated on download, the cache holds raw objects only
+    if (m_stCompressOptions.bDecompress && stMeta.sCodec == "gzip") return true;
+    return m_pObjectCache->warm(stTask.sBucket, stTask.sObjectKey, stMeta.sEtag, [&](const std::string& sTmpFile) {
+        return downloadForCache(stTask.sBucket, stTask.sObjectKey, sTmpFile, stMeta.nSize, stMeta.sEtag);
+    });
+}
+
+int MinIOManager::prefetchPlyTextures(const std::string& sBucket, const std::string& sPlyObject) {
+    ObjectMeta stMeta;
+    if (!statObject(sBucket, sPlyObject, stMeta) || stMeta.nSize == 0) return 0;
+    // the header is ascii at the start of the file, even for binary plys
+    std::string sHeader;
+    try {
+        size_t nOffset = 0;
+        size_t nLength = std::min<size_t>(stMeta.nSize, 64 << 10);
+        minio::s3::GetObjectArgs args;
+        args.bucket = sBucket;
+        args.object = sPlyObject;
+        args.offset = &nOffset;
+        args.length = &nLength;
+        args.datafunc = [&sHeader](minio::http::DataFunctionArgs stArgs) -> bool {
+            sHeader.append(stArgs.datachunk.data(), stArgs.datachunk.size());
+            return sHeader.find("end_header") == std::string::npos;
+        };
+        client().GetObject(args);
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->warn("Prefetch [{}] header exception: {}", sPlyObject, e.what());
+        return 0;
+    }
+    size_t nEnd = sHeader.find("end_header");
+    if (nEnd == std::string::npos) return 0;
+    sHeader.resize(nEnd);
+
+    std::string sDir;
+    size_t nSlash = sPlyObject.find_last_of('/');
+    if (nSlash != std::string::npos) sDir = sPlyObject.substr(0, nSlash + 1);
+    std::vector<std::string> vTextures;
+    std::istringstream ssHeader(sHeader);
+    std::string sLine;
+    while (std::getline(ssHeader, sLine)) {
+        if (!sLine.empty() && sLine.back() == '\r') sLine.pop_back();
+        const std::string sKey = "comment TextureFile ";
+        if (sLine.compare(0, sKey.size(), sKey) != 0) continue;
+        std::string sTexture = sLine.substr(sKey.size());
+        if (sTexture.empty()) continue;
+        vTextures.push_back(sTexture[0] == '/' ? sTexture.substr(1) : sDir + sTexture);
+    }
+    // textures are wanted right after the mesh, ahead of other prefetches
+    if (!vTextures.empty()) prefetch(sBucket, vTextures, 1);
+    return static_cast<int>(vTextures.size());
+}
+
+ObjectCacheStats MinIOManager::getObjectCacheStats() const {
+    return (m_pObjectCache ? m_pObjectCache->stats() : ObjectCacheStats());
+}
+
+bool MinIOManager::downloadCached(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath, 
+                        size_t nSize, std::string sEtag) {
+    auto funFetch = [&]() {
+        return m_pObjectCache->fetch(sBucket, sObject, sEtag, sSavePath, [&](const std::string& sTmpFile) {
+            return downloadForCache(sBucket, sObject, sTmpFile, nSize, sEtag);
+        });
+    };
+
+    bool bRes = false;
+    ObjectMeta stMeta;
+    if (!sEtag.empty()) {
+        bRes = funFetch();
+    } else if (statObject(sBucket, sObject, stMeta)) {
+        sEtag = stMeta.sEtag;
+        nSize = stMeta.nSize;
+        bRes = funFetch();
+        // the cached stat may name a replaced version, ask the server once more
+        if (!bRes && statObject(sBucket, sObject, stMeta, false) && stMeta.sEtag != sEtag) {
+            sEtag = stMeta.sEtag;
+            nSize = stMeta.nSize;
+            bRes = funFetch();
+        }
+    }
+    if (!bRes) {
+        spdlog::get("MinIOManager")->critical("Download [{}] through cache failed", sObject);
+    }
+    return bRes;
+}
+
+bool MinIOManager::downloadForCache(const std::string& sBucket, const std::string& sObject, const std::string& sTmpFile,
+                        size_t nSize, const std::string& sEtag) {
+    if (m_stRangedOptions.nThreshold > 0 && nSize >= m_stRangedOptions.nThreshold) {
+        // the cache key names this version, never store another one under it
+        return downloadObjectRanged(sBucket, sObject, sTmpFile, sEtag);
+    }
+    ObjectMeta stVerifyMeta;
+    if (m_stVerifyOptions.bEnabled && statObject(sBucket, sObject, stVerifyMeta) && stVerifyMeta.sEtag == sEtag) {
+        return getObjectVerified(sBucket, sObject, sTmpFile, stVerifyMeta);
+    }
+    return getObjectToFile(sBucket, sObject, sTmpFile, sEtag);
+}
+
+bool MinIOManager::getObjectToFile(const std::string& sBucket, const std::string& sObject, 
+                        const std::string& sSavePath, const std::string& sEtag, TransferDigest* pDigest) {
+    std::ofstream fsOut(sSavePath, std::ios::binary | std::ios::trunc);
+    if (!fsOut.is_open()) return false;
+    try {
+        minio::s3::GetObjectArgs args;
+        args.bucket = sBucket;
+        args.object = sObject;
+        // the cache key names this version, never store another one under it
+        args.match_etag = sEtag;
+        args.datafunc = [this, &fsOut, pDigest](minio::http::DataFunctionArgs args) -> bool {
+            throttle(args.datachunk.size());
+            if (pDigest) pDigest->update(args.datachunk);
+            fsOut.write(args.datachunk.data(), args.datachunk.size());
+            return fsOut.good();
+        };
+        auto response = client().GetObject(args);
+        if (!response) {
+            spdlog::get("MinIOManager")->critical("Download [{}] failed: {}", sObject, response.Error().String());
+            return false;
+        }
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Download Exception: {}", e.what());
+        return false;
+    }
+    fsOut.close();
+    return !fsOut.fail();
+}
+
+void MinIOManager::setVerifyOptions(const VerifyOptions& stOptions) {
+    m_stVerifyOptions = stOptions;
+}
+
+// a single part upload without sse has the content md5 as etag, multipart ones end in "-<parts>",
+// sse etags look the same but are not md5, so those give "" as well
+static std::string plainEtagMd5(const ObjectMeta& stMeta) {
+    if (stMeta.bEncrypted) return "";
+    std::string sMd5 = stMeta.sEtag;
+    sMd5.erase(std::remove(sMd5.begin(), sMd5.end(), '"'), sMd5.end());
+    if (sMd5.size() != 32 || !std::all_of(sMd5.begin(), sMd5.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); })) {
+        return "";
+    }
+    std::transform(sMd5.begin(), sMd5.end(), sMd5.begin(), [](char c) { return std::tolower(static_cast<unsigned char>(c)); });
+    return sMd5;
+}
+
+bool MinIOManager::checkDigest(const ObjectMeta& stMeta, TransferDigest& stDigest, const std::string& sObject) const {
+    if (stDigest.nBytes != stMeta.nSize) {
+        spdlog::get("MinIOManager")->warn("Download [{}] size {} != {}", sObject, stDigest.nBytes, stMeta.nSize);
+        return false;
+    }
+    if (stDigest.bCrc32c && Crc32c::toHex(stDigest.nCrc32c) != stMeta.sCrc32c) {
+        spdlog::get("MinIOManager")->warn("Download [{}] crc32c {} != {}", sObject, Crc32c::toHex(stDigest.nCrc32c), stMeta.sCrc32c);
+        return false;
+    }
+    if (stDigest.bMd5) {
+        std::string sMd5 = stDigest.stMd5.finalHex();
+        if (sMd5 != plainEtagMd5(stMeta)) {
+            spdlog::get("MinIOManager")->warn("Download [{}] md5 {} != etag {}", sObject, sMd5, stMeta.sEtag);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MinIOManager::getObjectVerified(const std::string& sBucket, const std::string& sObject, 
+                        const std::string& sSavePath, const ObjectMeta& stMeta) {
+    std::string sTmpPath = sSavePath + ".verify";
+    std::error_code ec;
+    for (int nTry = 0; nTry <= m_stVerifyOptions.nRetries; ++nTry) {
+        if (nTry > 0) m_stMetrics.addRetry(sBucket);
+        TransferDigest stDigest;
+        // crc32c is cheaper and also covers multipart objects, md5 only where the etag is one, else size only
+        stDigest.bCrc32c = !stMeta.sCrc32c.empty();
+        stDigest.bMd5 = !stDigest.bCrc32c && m_stVerifyOptions.bEtagMd5 && !plainEtagMd5(stMeta).empty();
+        // pinned to the version, a replaced object fails here instead of mismatching
+        if (!getObjectToFile(sBucket, sObject, sTmpPath, stMeta.sEtag, &stDigest)) break;
+        if (checkDigest(stMeta, stDigest, sObject)) {
+            std::filesystem::rename(sTmpPath, sSavePath, ec);
+            return !ec;
+        }
+        spdlog::get("MinIOManager")->warn("Download [{}] checksum mismatch, try {} again", sObject, nTry + 1);
+    }
+    std::filesystem::remove(sTmpPath, ec);
+    spdlog::get("MinIOManager")->critical("Download [{}] failed verification", sObject);
+    return false;
+}
+
+bool MinIOManager::downloadVerified(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath) {
+    ObjectMeta stMeta;
+    if (!statObject(sBucket, sObject, stMeta)) return false;
+    if (m_stRangedOptions.nThreshold > 0 && stMeta.nSize >= m_stRangedOptions.nThreshold) {
+        return downloadObjectRanged(sBucket, sObject, sSavePath);
+    }
+    if (getObjectVerified(sBucket, sObject, sSavePath, stMeta)) return true;
+    // the cached stat may name a replaced version
+    ObjectMeta stFresh;
+    if (statObject(sBucket, sObject, stFresh, false) && stFresh.sEtag != stMeta.sEtag) {
+        return getObjectVerified(sBucket, sObject, sSavePath, stFresh);
+    }
+    return false;
+}
+
+std::string MinIOManager::uploadChecksum(const std::string& sLocalPathName) const {
+    if (!m_stVerifyOptions.bEnabled) return "";
+    int nFd = open(sLocalPathName.c_str(), O_RDONLY);
+    if (nFd < 0) return "";
+    struct stat stStat;
+    uint32_t nCrc = 0;
+    bool bOk = (fstat(nFd, &stStat) == 0);
+    size_t nSize = (bOk ? static_cast<size_t>(stStat.st_size) : 0);
+    if (nSize > 0) {
+        void* pMap = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, nFd, 0);
+        bOk = (pMap != MAP_FAILED);
+        if (bOk) {
+            // the sdk reads the file right after, the pages stay cached for it
+            madvise(pMap, nSize, MADV_SEQUENTIAL);
+            nCrc = Crc32c::extend(0, static_cast<const char*>(pMap), nSize);
+            munmap(pMap, nSize);
+        }
+    }
+    close(nFd);
+    return (bOk ? Crc32c::toHex(nCrc) : "");
+}
+
 void MinIOManager::addTask(const std::string& sBucket, const std::string &sObject, const std::string &sSaveName, bool bDownload) {
     std::lock_guard<std::mutex> locker(m_stMutexQueue);
     if (bDownload)
@@ -201,7 +1607,7 @@ void MinIOManager::worker(bool bDownload) {
                 args.object = sObject;
                 args.filename = sSaveName;
 
-                auto response = m_stClient.DownloadObject(args);
+                auto response = client().DownloadObject(args);
 
                 if (!response) {
                     spdlog::get("MinIOManager")->critical("Download {} / {} failed: {} ", sBucket, sObject, response.Error().String());
@@ -213,7 +1619,7 @@ void MinIOManager::worker(bool bDownload) {
                 args.bucket = sBucket;
                 args.object = sObject;
                 args.filename = sSaveName;
-                auto response = m_stClient.UploadObject(args);
+                auto response = client().UploadObject(args);
                 if (!response) {
                     spdlog::get("MinIOManager")->critical("Upload {} -> {} failed : {} ", sSaveName, sObject, response.Error().String());
                     continue;
@@ -240,7 +1646,9 @@ void MinIOManager::start(int nNumThreads, bool bDownload) {
 
 int MinIOManager::downloadDirectoryInThread(const std::string& sBucket,
                         const std::string& sObject,
-                        const std::string& sSavePath) {
+                        const std::string& sSavePath,
+                        TransferSummary* pSummary) {
+    BatchScope stBatch(m_stMetrics, pSummary);
 
     if (!bucketExists(sBucket)) {
         std::cerr << "Bucket '" << sBucket << "' not found or unaccessable" << std::endl;
@@ -250,20 +1658,66 @@ int MinIOManager::downloadDirectoryInThread(const std::string& sBucket,
         if (!std::filesystem::exists(sSavePath))
             std::filesystem::create_directories(sSavePath);
 
-        auto vObjects = listObjects(sBucket, sObject);
-        if (vObjects.empty()) {
+        std::vector<minio::s3::Item> vObjects;
+        bool bListed = listObjectItems(sBucket, sObject, vObjects);
+        bool bSync = (m_stSyncOptions.bIncremental || m_stSyncOptions.bDeleteOrphans);
+        if (vObjects.empty() && !bSync) {
             return EXIT_SUCCESS;
         }
-        std::cout << "Need download " << vObjects.size() << std::endl;
 
-        for (const auto& sObjectName : vObjects) {
-            std::string sSaveName = sSavePath + "/" + sObjectName.substr(sObject.length());
+        SyncManifest stManifest;
+        if (bSync) stManifest.load(sSavePath + "/" + m_stSyncOptions.sManifestName);
+
+        std::unordered_set<std::string> setRemote;
+        std::unordered_map<std::string, const minio::s3::Item*> mapScheduled;
+        for (const auto& item : vObjects) {
+            std::string sRelName = item.name.substr(sObject.length());
+            if (!sRelName.empty() && sRelName[0] == '/') sRelName.erase(0, 1);
+            std::string sSaveName = sSavePath + "/" + sRelName;
+            if (m_stSyncOptions.bDeleteOrphans) setRemote.insert(sRelName);
+            if (m_stSyncOptions.bIncremental && stManifest.unchanged(sRelName, sSaveName, item.etag)) continue;
         
-            stDownUpManager.addTask({sBucket, sObjectName, sSaveName});
+            MinioTask stTask(sBucket, item.name, sSaveName, false, item.size);
+            stTask.sEtag = item.etag;
+            prioritize(stTask);
+            stDownUpManager.addTask(stTask);
+            mapScheduled.insert({sSaveName, &item});
         }
+        std::cout << "Need download " << mapScheduled.size() << " of " << vObjects.size() << std::endl;
 
-        stDownUpManager.start();
-        stDownUpManager.waitForComplete();
+        stDownUpManager.takeFailedTasks();
+        if (!mapScheduled.empty()) {
+            stDownUpManager.start();
+            stDownUpManager.waitForComplete();
+        }
+
+        if (bSync) {
+            for (const auto& stTask : stDownUpManager.takeFailedTasks()) {
+                mapScheduled.erase(stTask.sFileFullName);
+            }
+            for (const auto& item : mapScheduled) {
+                SyncEntry stEntry;
+                if (!SyncManifest::localState(item.first, stEntry)) continue;
+                stEntry.sEtag = item.second->etag;
+                stManifest.update(item.first.substr(sSavePath.length() + 1), stEntry);
+            }
+            // a failed listing must never look like an empty bucket
+            if (m_stSyncOptions.bDeleteOrphans && bListed && std::filesystem::is_directory(sSavePath)) {
+                std::vector<std::filesystem::path> vOrphans;
+                for (const auto& entry : std::filesystem::recursive_directory_iterator(sSavePath)) {
+                    if (!entry.is_regular_file()) continue;
+                    std::string sRelName = std::filesystem::relative(entry.path(), sSavePath).generic_string();
+                    if (!isImageObject(sRelName) || isPartialFile(sRelName) || setRemote.count(sRelName) > 0) continue;
+                    vOrphans.push_back(entry.path());
+                    stManifest.erase(sRelName);
+                }
+                for (const auto& fsOrphan : vOrphans) {
+                    std::filesystem::remove(fsOrphan);
+                }
+                std::cout << "Delete local orphans " << vOrphans.size() << std::endl;
+            }
+            stManifest.save();
+        }
     } catch (const std::exception &e) {
         spdlog::get("MinIOManager")->critical("download exception: {}", e.what());
         return EXIT_FAILURE;
@@ -275,8 +1729,9 @@ int MinIOManager::downloadDirectoryInThread(const std::string& sBucket,
 int MinIOManager::uploadDirectoryInThread(const std::string& sBucket,
                         const std::string& sObject,
                         const std::string& sLocalPath,
-                        bool bRecursive) {
-
+                        bool bRecursive,
+                        TransferSummary* pSummary) {
+    BatchScope stBatch(m_stMetrics, pSummary);
     if (!std::filesystem::exists(sLocalPath)) {
         std::cerr << "local path '" << sLocalPath << "' not found or unaccessable" << std::endl;
         return EXIT_FAILURE;
@@ -286,20 +1741,92 @@ int MinIOManager::uploadDirectoryInThread(const std::string& sBucket,
             return EXIT_FAILURE;
         }
     }
+    if (m_stPackOptions.bEnabled) {
+        return uploadDirectoryPacked(sBucket, sObject, sLocalPath, bRecursive);
+    }
     try {
-        std::vector<std::string> vFiles = listFiles(sLocalPath);
-        if (vFiles.empty()) return 0;
-
-        std::cout << "Need upload " << vFiles.size() << std::endl;
-
-        for (const auto& sName : vFiles) {
-            std::string sSaveName = sLocalPath + "/" + sName;
-
-            stDownUpManager.addTask({sBucket, sObject + "/" + sName, sSaveName, true});
+        bool bSync = (m_stSyncOptions.bIncremental || m_stSyncOptions.bDeleteOrphans);
+        SyncManifest stManifest;
+        std::unordered_map<std::string, size_t> mapRemote;
+        bool bListed = false;
+        if (bSync) {
+            stManifest.load(sLocalPath + "/" + m_stSyncOptions.sManifestName);
+            std::vector<minio::s3::Item> vRemote;
+            bListed = listObjectItems(sBucket, sObject + "/", vRemote, false);
+            for (const auto& item : vRemote) mapRemote.insert({item.name, item.size});
         }
 
+        // uploads start while the directory tree is still being scanned
+        std::mutex mutexScan;
+        std::unordered_set<std::string> setLocal;
+        std::unordered_map<std::string, std::string> mapScheduled;
+        size_t nFiles = 0;
+        stDownUpManager.takeFailedTasks();
+        stDownUpManager.beginFeed();
         stDownUpManager.start();
+        bool bScanned = DirectoryWalker::walk(sLocalPath, bRecursive, m_nScanThreads, [&](std::vector<std::string>& vFiles) {
+            std::vector<MinioTask> vTasks;
+            std::vector<std::string> vObjectKeys;
+            for (const auto& sName : vFiles) {
+                if (sName == m_stSyncOptions.sManifestName || sName == m_stSyncOptions.sManifestName + ".tmp") continue;
+                // a download into the tree may be in progress
+                if (isPartialFile(sName)) continue;
+                std::string sSaveName = sLocalPath + "/" + sName;
+                std::string sObjectKey = sObject + "/" + sName;
+                if (bSync) vObjectKeys.push_back(sObjectKey);
+                if (m_stSyncOptions.bIncremental && stManifest.unchanged(sName, sSaveName)) {
+                    // skip only if the remote copy is still there
+                    auto itr = mapRemote.find(sObjectKey);
+                    // compressed objects differ in size from their files
+                    if (itr != mapRemote.end() && (itr->second == stManifest.find(sName)->nSize || shouldCompress(sSaveName))) continue;
+                }
+                vTasks.push_back({sBucket, sObjectKey, sSaveName, true});
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutexScan);
+                nFiles += vFiles.size();
+                setLocal.insert(vObjectKeys.begin(), vObjectKeys.end());
+                for (const auto& stTask : vTasks) {
+                    mapScheduled.insert({stTask.sFileFullName, stTask.sFileFullName.substr(sLocalPath.length() + 1)});
+                }
+            }
+            for (auto& stTask : vTasks) prioritize(stTask);
+            stDownUpManager.addTasks(vTasks);
+        });
+        stDownUpManager.endFeed();
         stDownUpManager.waitForComplete();
+        std::cout << "Uploaded " << mapScheduled.size() << " of " << nFiles << std::endl;
+
+        if (bSync) {
+            for (const auto& stTask : stDownUpManager.takeFailedTasks()) {
+                mapScheduled.erase(stTask.sFileFullName);
+            }
+            for (const auto& item : mapScheduled) {
+                SyncEntry stEntry;
+                if (SyncManifest::localState(item.first, stEntry)) stManifest.update(item.second, stEntry);
+            }
+            // an unreadable sub directory must not look like deleted files
+            if (m_stSyncOptions.bDeleteOrphans && bListed && bScanned) {
+                size_t nOrphans = 0;
+                for (const auto& item : mapRemote) {
+                    if (setLocal.count(item.first) > 0) continue;
+                    // the listing is recursive, a flat upload never saw the sub directories
+                    if (!bRecursive && item.first.find('/', sObject.length() + 1) != std::string::npos) continue;
+                    minio::s3::RemoveObjectArgs args;
+                    args.bucket = sBucket;
+                    args.object = item.first;
+                    auto response = client().RemoveObject(args);
+                    if (!response) {
+                        spdlog::get("MinIOManager")->error("Remove orphan {}/{} failed: {}", sBucket, item.first, response.Error().String());
+                        continue;
+                    }
+                    m_stMetaCache.invalidateObject(sBucket, item.first);
+                    ++nOrphans;
+                }
+                std::cout << "Delete remote orphans " << nOrphans << std::endl;
+            }
+            stManifest.save();
+        }
     } catch (const std::exception &e) {
         spdlog::get("MinIOManager")->critical("download exception: {}", e.what());
         return EXIT_FAILURE;
@@ -326,29 +1853,116 @@ bool MinIOManager::parseBrowserAddr(const std::string& sMinIOUrl) {
     return EXIT_SUCCESS;
 }
 
+void MinIOManager::setSyncOptions(const SyncOptions& stOptions) {
+    m_stSyncOptions = stOptions;
+}
+
+void MinIOManager::setBandwidthLimiter(std::shared_ptr<BandwidthLimiter> pLimiter, const std::string& sJobId) {
+    m_pLimiter = std::move(pLimiter);
+    m_sJobId = sJobId;
+}
+
+std::vector<JobThroughput> MinIOManager::getThroughput() const {
+    return (m_pLimiter ? m_pLimiter->throughput() : std::vector<JobThroughput>());
+}
+
+std::map<std::string, TransferSummary> MinIOManager::getMetrics() const {
+    return m_stMetrics.buckets();
+}
+
+std::string MinIOManager::metricsText() const {
+    return m_stMetrics.prometheusText();
+}
+
+void MinIOManager::throttle(size_t nBytes) {
+    if (m_pLimiter && nBytes > 0) m_pLimiter->acquire(m_sJobId, nBytes);
+}
+
+minio::http::ProgressFunction MinIOManager::throttleProgress(bool bUpload) {
+    if (!m_pLimiter) return nullptr;
+    // the sdk reports running totals, one call per transfer owns this counter
+    auto pLast = std::make_shared<double>(0);
+    return [this, bUpload, pLast](minio::http::ProgressFunctionArgs args) -> bool {
+        double fDone = (bUpload ? args.uploaded_bytes : args.downloaded_bytes);
+        if (fDone > *pLast) {
+            throttle(static_cast<size_t>(fDone - *pLast));
+            *pLast = fDone;
+        }
+        return true;
+    };
+}
+
+void MinIOManager::setScanThreads(size_t nThreads) {
+    m_nScanThreads = std::max<size_t>(1, nThreads);
+}
+
 bool MinIOManager::setValid(bool bValid) {
     m_bValid = bValid;
 }
 
 bool MinIOManager::workerDownUp(const MinioTask& stTask, const std::atomic<bool>& bStopFlag) {
+    auto tpStart = TransferMetrics::Clock::now();
+    auto stMetaBefore = t_stMetaTime;
+    m_stMetrics.beginObject(stTask.sBucket);
+    bool bRes = transferTask(stTask, bStopFlag);
+    auto stTotal = TransferMetrics::Clock::now() - tpStart;
+    m_stMetrics.addPhase(stTask.sBucket, TransferPhase::Transfer, stTotal - (t_stMetaTime - stMetaBefore));
+    uint64_t nBytes = 0;
+    if (bRes) {
+        std::error_code ec;
+        nBytes = std::filesystem::file_size(stTask.sFileFullName, ec);
+        if (ec) nBytes = stTask.nSize;
+    }
+    m_stMetrics.endObject(stTask.sBucket, nBytes, stTotal, bRes);
+    return bRes;
+}
+
+bool MinIOManager::transferTask(const MinioTask& stTask, const std::atomic<bool>& bStopFlag) {
     try {
         if (stTask.bUpload) {
+            if (shouldCompress(stTask.sFileFullName)) {
+                return uploadCompressed(stTask.sBucket, stTask.sObjectKey, stTask.sFileFullName);
+            }
+            std::error_code ec;
+            size_t nFileSize = std::filesystem::file_size(stTask.sFileFullName, ec);
+            if (!ec && nFileSize > 0 && nFileSize >= m_stMultipartOptions.nThreshold) {
+                return uploadObjectMultipart(stTask.sBucket, stTask.sObjectKey, stTask.sFileFullName);
+            }
             minio::s3::UploadObjectArgs args;
             args.bucket = stTask.sBucket;
             args.object = stTask.sObjectKey;
             args.filename = stTask.sFileFullName;
-            auto response = m_stClient.UploadObject(args);
+            args.progressfunc = throttleProgress(true);
+            std::string sCrc32c = uploadChecksum(stTask.sFileFullName);
+            if (!sCrc32c.empty()) args.user_metadata.Add("crc32c", sCrc32c);
+            auto response = client().UploadObject(args);
             if (!response) {
                 spdlog::get("MinIOManager")->critical("Upload {} -> {}/{} failed : {} ", stTask.sFileFullName, stTask.sBucket, stTask.sObjectKey, response.Error().String());
                 return false;
             }
+            m_stMetaCache.invalidateObject(stTask.sBucket, stTask.sObjectKey);
         } else {
+            ObjectMeta stCodecMeta;
+            if (m_stCompressOptions.bDecompress && statObject(stTask.sBucket, stTask.sObjectKey, stCodecMeta) 
+                && stCodecMeta.sCodec == "gzip") {
+                return downloadDecompressed(stTask.sBucket, stTask.sObjectKey, stTask.sFileFullName);
+            }
+            if (m_pObjectCache) {
+                return downloadCached(stTask.sBucket, stTask.sObjectKey, stTask.sFileFullName, stTask.nSize, stTask.sEtag);
+            }
+            if (m_stVerifyOptions.bEnabled) {
+                return downloadVerified(stTask.sBucket, stTask.sObjectKey, stTask.sFileFullName);
+            }
+            if (m_stRangedOptions.nThreshold > 0 && stTask.nSize >= m_stRangedOptions.nThreshold) {
+                return downloadObjectRanged(stTask.sBucket, stTask.sObjectKey, stTask.sFileFullName);
+            }
             minio::s3::DownloadObjectArgs args;
             args.bucket = stTask.sBucket;
             args.object = stTask.sObjectKey;
             args.filename = stTask.sFileFullName;
             args.overwrite = true;
-            auto response = m_stClient.DownloadObject(args);
+            args.progressfunc = throttleProgress(false);
+            auto response = client().DownloadObject(args);
             if (!response) {
                 spdlog::get("MinIOManager")->error("Download {} / {} failed: {} ", stTask.sBucket, stTask.sObjectKey, response.Error().String());
                 return false;
@@ -361,15 +1975,64 @@ bool MinIOManager::workerDownUp(const MinioTask& stTask, const std::atomic<bool>
     return true;
 }
 
-int MinIOManager::downloadJsonListInThread(const std::string& sBucket, const std::vector<std::string> &vObjects, const std::string& sLocalPath) {
+int MinIOManager::downloadFilteredInThread(const std::string& sBucket,
+                        const std::string& sPrefix,
+                        const std::string& sLocalPath,
+                        const ObjectFilter& stFilter,
+                        TransferSummary* pSummary) {
+    BatchScope stBatch(m_stMetrics, pSummary);
+    if (!bucketExists(sBucket)) {
+        std::cerr << "Bucket '" << sBucket << "' not found or unaccessable" << std::endl;
+        return EXIT_FAILURE;
+    }
+    bool bListed = false;
+    try {
+        if (!std::filesystem::exists(sLocalPath))
+            std::filesystem::create_directories(sLocalPath);
+
+        stDownUpManager.takeFailedTasks();
+        stDownUpManager.beginFeed();
+        stDownUpManager.start();
+        size_t nScheduled = 0;
+        bListed = listObjectsPaged(sBucket, sPrefix, stFilter, [&](std::vector<minio::s3::Item>& vPage) {
+            std::vector<MinioTask> vTasks;
+            vTasks.reserve(vPage.size());
+            for (const auto& item : vPage) {
+                std::string sRelName = item.name.substr(sPrefix.length());
+                if (!sRelName.empty() && sRelName[0] == '/') sRelName.erase(0, 1);
+                MinioTask stTask(sBucket, item.name, sLocalPath + "/" + sRelName, false, item.size);
+                stTask.sEtag = item.etag;
+                vTasks.push_back(std::move(stTask));
+            }
+            for (auto& stTask : vTasks) prioritize(stTask);
+            stDownUpManager.addTasks(vTasks);
+            nScheduled += vTasks.size();
+            return true;
+        }, 256);
+        stDownUpManager.endFeed();
+        stDownUpManager.waitForComplete();
+        std::cout << "Downloaded " << nScheduled << " objects" << std::endl;
+    } catch (const std::exception& e) {
+        spdlog::get("MinIOManager")->critical("Download Exception: {}", e.what());
+        return EXIT_FAILURE;
+    }
+    return ((bListed && stDownUpManager.takeFailedTasks().empty()) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+int MinIOManager::downloadJsonListInThread(const std::string& sBucket, const std::vector<std::string> &vObjects, const std::string& sLocalPath,
+                        TransferSummary* pSummary) {
+    BatchScope stBatch(m_stMetrics, pSummary);
     if (!bucketExists(sBucket)) {
         spdlog::get("MinIOManager")->info("Bucket '{}' not found or unaccessable", sBucket);
         return EXIT_FAILURE;
     }
+    bool bTasksOk = false;
     try {
         if (!std::filesystem::exists(sLocalPath))
             std::filesystem::create_directories(sLocalPath);
 
+        // failures of an earlier batch on the shared manager are not ours
+        stDownUpManager.takeFailedTasks();
         for (const auto& sObjectName : vObjects) {
             auto pos = sObjectName.find_last_of("/");
             std::string sSaveNameOnly;
@@ -379,19 +2042,24 @@ int MinIOManager::downloadJsonListInThread(const std::string& sBucket, const std
                 sSaveNameOnly = sObjectName.substr(pos + 1);
             }
             std::string sSaveName = sLocalPath + "/" + sSaveNameOnly;
-            stDownUpManager.addTask({sBucket, sObjectName, sSaveName});
+            MinioTask stTask(sBucket, sObjectName, sSaveName);
+            prioritize(stTask);
+            stDownUpManager.addTask(stTask);
         }
 
         stDownUpManager.start();
         stDownUpManager.waitForComplete();
+        bTasksOk = stDownUpManager.takeFailedTasks().empty();
     } catch (const std::exception &e) {
         spdlog::get("MinIOManager")->critical("download exception: {}", e.what());
         return EXIT_FAILURE;
     }
-    return EXIT_SUCCESS;
+    return (bTasksOk ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
-int MinIOManager::uploadJsonListInThread(const std::string& sBucket, std::unordered_map<std::string, std::string> &mapObjectKey, const std::string& sLocalPath) {
+int MinIOManager::uploadJsonListInThread(const std::string& sBucket, std::unordered_map<std::string, std::string> &mapObjectKey, const std::string& sLocalPath,
+                        TransferSummary* pSummary) {
+    BatchScope stBatch(m_stMetrics, pSummary);
     if (!std::filesystem::exists(sLocalPath)) {
         std::cerr << "local path '" << sLocalPath << "' not found or unaccessable" << std::endl;
         return EXIT_FAILURE;
@@ -406,17 +2074,44 @@ int MinIOManager::uploadJsonListInThread(const std::string& sBucket, std::unorde
             return EXIT_FAILURE;
         }
     }
+    bool bTasksOk = false;
     try {
-        for (auto item : mapObjectKey) {
-            stDownUpManager.addTask({sBucket, item.second, item.first, true});
+        // queued in full before start, so manifests and root tiles leave first
+        std::vector<MinioTask> vTasks;
+        vTasks.reserve(mapObjectKey.size());
+        for (const auto& item : mapObjectKey) {
+            vTasks.push_back({sBucket, item.second, item.first, true});
+            prioritize(vTasks.back());
         }
+        stDownUpManager.takeFailedTasks();
+        stDownUpManager.addTasks(vTasks);
         stDownUpManager.start();
         stDownUpManager.waitForComplete();
+        bTasksOk = stDownUpManager.takeFailedTasks().empty();
     } catch (const std::exception &e) {
         spdlog::get("MinIOManager")->critical("upload exception: {}", e.what());
         return EXIT_FAILURE;
     }
-    return EXIT_SUCCESS;
+    return (bTasksOk ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void MinIOManager::setPriorityPolicy(std::function<int(const MinioTask&)> funPriority) {
+    m_funPriority = std::move(funPriority);
+}
+
+int MinIOManager::defaultPriority(const MinioTask& stTask) {
+    const std::string& sKey = stTask.sObjectKey;
+    size_t nSlash = sKey.find_last_of('/');
+    std::string_view sName(sKey.c_str() + (nSlash == std::string::npos ? 0 : nSlash + 1));
+    int nDepth = static_cast<int>(std::count(sKey.begin(), sKey.end(), '/'));
+    // the viewer starts from tileset.json and walks down through nested tilesets
+    if (sName == "tileset.json") return 2000000 - nDepth;
+    if (sName.size() > 5 && sName.substr(sName.size() - 5) == ".json") return 1000000 - nDepth;
+    return -nDepth;
+}
+
+void MinIOManager::prioritize(MinioTask& stTask) const {
+    if (m_funPriority) stTask.nPriority = m_funPriority(stTask);
 }
 
 void MinIOManager::cancelDownUp() {
@@ -7,9 +7,23 @@
 #include <queue>
 #include <unordered_set>
 #include <filesystem>
+#include <functional>
+#include <string_view>
 
 #include <miniocpp/client.h>
 
+#include "BandwidthLimiter.hpp"
+#include "Checksum.hpp"
+#include "ClientPool.hpp"
+#include "Compression.hpp"
+#include "DirectoryWalker.hpp"
+#include "MetadataCache.hpp"
+#include "ObjectCache.hpp"
+#include "ObjectFilter.hpp"
+#include "PackIndex.hpp"
+#include "SyncManifest.hpp"
+#include "TransferMetrics.hpp"
+#include "TransferCheckpoint.hpp"
 #include "TaskManager.hpp"
 
 struct MinioTask {
@@ -17,9 +31,93 @@ struct MinioTask {
     std::string sObjectKey;
     std::string sFileFullName;
     bool bUpload = false;
+    size_t nSize = 0;       // object size from listing, 0 if unknown
+    std::string sEtag;      // object etag from listing, empty if unknown
+    int nPriority = 0;      // larger is transferred first
     MinioTask() {}
-    MinioTask(const std::string& _sBucket, const std::string& _sObjectKey, const std::string& _sFileFullName, bool _bUpload = false) 
-        : sBucket(_sBucket), sObjectKey(_sObjectKey), sFileFullName(_sFileFullName), bUpload(_bUpload) {}
+    MinioTask(const std::string& _sBucket, const std::string& _sObjectKey, const std::string& _sFileFullName, bool _bUpload = false, size_t _nSize = 0) 
+        : sBucket(_sBucket), sObjectKey(_sObjectKey), sFileFullName(_sFileFullName), bUpload(_bUpload), nSize(_nSize) {}
+};
+
+struct MultipartOptions {
+    size_t nPartSize = 64ull << 20;         // adjusted to [5MB, size / 10000] by s3 limits
+    size_t nPartConcurrency = 4;            // parts in flight per object
+    size_t nThreshold = 256ull << 20;       // files at least this large upload in parts
+    int nPartRetries = 3;                   // retries of one failed part
+};
+
+struct RangedDownloadOptions {
+    size_t nRangeSize = 32ull << 20;
+    size_t nConcurrency = 4;                // ranges in flight per object
+    // objects at least this large download in ranges, downloadObject only goes ranged when the size is
+    // known without a stat (directory listings, the metadata cache), else downloadObjectRanged directly
+    size_t nThreshold = 256ull << 20;
+    int nRangeRetries = 3;                  // retries of one failed range
+};
+
+// gzip on upload by extension, recorded as "codec: gzip" user metadata plus "Content-Encoding: gzip" so
+// viewers fetching tileset.json or tiles over http get them inflated; inflated again on download with bDecompress
+struct CompressionOptions {
+    bool bCompress = false;
+    bool bDecompress = false;               // stat each download for its codec
+    // textures like jpg/png/webp are compressed already and stay raw
+    ObjectFilter stFilter = ObjectFilter::extensions({
+        "ply", "glb", "gltf", "json", "b3dm", "pnts", "i3dm", "cmpt", "obj", "las", "xyz", "txt",
+    });
+    size_t nMinSize = 4ull << 10;           // smaller files are not worth it
+    int nLevel = 6;
+    size_t nChunkSize = 4ull << 20;         // input bytes per gzip member
+    size_t nThreads = 4;                    // members compressed at once
+};
+
+// one part of a streamed upload, owns its bytes until uploaded
+struct StreamPartTask {
+    unsigned int nPartNumber = 0;
+    std::shared_ptr<std::string> pData;
+};
+
+// small files of a directory upload packed into archive objects, see PackIndex
+struct PackOptions {
+    bool bEnabled = false;                  // uploadDirectoryInThread packs, sync options do not apply then
+    size_t nMaxMemberSize = 256ull << 10;   // larger files upload as their own object
+    size_t nArchiveSize = 64ull << 20;      // archives are closed once this large
+    size_t nConcurrency = 4;                // archives built and uploaded at once
+};
+
+// one archive of a packed upload
+struct PackArchiveTask {
+    uint32_t nArchive = 0;
+    std::vector<std::string> vMembers;      // relative paths in archive order
+};
+
+// multipart uploads and ranged downloads keep a checkpoint in sDir, "<name>.<path hash>.multipart.ckpt" /
+// ".ranged.ckpt", and continue from it after a failure; off by default since a failed upload then keeps
+// its parts on the server until resumed or cleaned up
+struct CheckpointOptions {
+    bool bEnabled = false;
+    int64_t nStaleSeconds = 7 * 24 * 3600;  // older checkpoints are discarded instead of resumed
+    std::string sDir;                       // empty: <temp dir>/minio_checkpoints
+};
+
+// one part of a multipart upload or one range of a ranged download
+struct MinioPartTask {
+    unsigned int nPartNumber = 0;
+    size_t nOffset = 0;
+    size_t nLength = 0;
+};
+
+// checksums computed while the bytes stream, compared with the object's "crc32c" user metadata,
+// else with a single part etag (md5), else only the size is checked; uploads are tagged with "crc32c"
+struct VerifyOptions {
+    bool bEnabled = false;
+    int nRetries = 2;                       // downloads again after a mismatch
+    bool bEtagMd5 = true;                   // take 32 hex etags of unencrypted objects for the md5, else size only
+};
+
+struct SyncOptions {
+    bool bIncremental = false;          // skip files unchanged since the last sync of the directory
+    bool bDeleteOrphans = false;        // delete remote (upload) or local (download) files missing on the source side
+    std::string sManifestName = ".minio_sync";  // kept in the local directory
 };
 
 class MinIOManager {
@@ -28,6 +126,11 @@ public:
                  bool bHttps,
                  const std::string& access_key, 
                  const std::string& secret_key);
+    // several nodes of one deployment, worker threads are spread over them round robin
+    MinIOManager(const std::vector<std::string>& vEndpoints, 
+                 bool bHttps,
+                 const std::string& access_key, 
+                 const std::string& secret_key);
                  
     ~MinIOManager();
 
@@ -36,6 +139,20 @@ public:
     bool downloadObject(const std::string& sBucket, 
                     const std::string& object_name,
                     const std::string& local_path);
+    // stream the object through funOnData without touching disk, return false from it to stop
+    bool downloadStream(const std::string& sBucket, 
+                    const std::string& sObject,
+                    const std::function<bool(std::string_view)>& funOnData);
+    // whole object into memory, nPadding zeroed bytes stay reserved past size(), ex: simdjson::SIMDJSON_PADDING
+    bool downloadToBuffer(const std::string& sBucket, const std::string& sObject, std::string& sBuffer, size_t nPadding = 0);
+    bool downloadToBuffer(const std::string& sBucket, const std::string& sObject, std::vector<uint8_t>& vBuffer, size_t nPadding = 0);
+    // fetch byte ranges concurrently into a preallocated file, verified against size/etag;
+    // sEtag pins the version, the download fails if the object has changed since
+    bool downloadObjectRanged(const std::string& sBucket, 
+                    const std::string& sObject,
+                    const std::string& sSavePath,
+                    const std::string& sEtag = "");
+    void setRangedDownloadOptions(const RangedDownloadOptions& stOptions);
     int downloadDirectory(const std::string& sBucket,
                         const std::string& remote_path,
                         const std::string& local_base_dir);
@@ -43,47 +160,209 @@ public:
 
     int uploadDirectory(const std::string &sBucket, const std::string &sObject, const std::string &sLocalPath, bool bRecursive = false);
     bool uploadObject(const std::string &sBucket, const std::string &sObject, const std::string &sLocalPathName);
+    // upload parts of the mmaped file concurrently, a failed part retries alone
+    bool uploadObjectMultipart(const std::string &sBucket, const std::string &sObject, const std::string &sLocalPathName);
+    void setMultipartOptions(const MultipartOptions& stOptions);
+    // in-memory payload, in parts once at least MultipartOptions::nThreshold (and 5MB)
+    bool uploadBuffer(const std::string& sBucket, const std::string& sObject, std::string_view sData);
+    bool uploadBuffer(const std::string& sBucket, const std::string& sObject, const std::vector<uint8_t>& vData);
+    // funProducer writes the payload through the given function (false aborts), parts are sent while it
+    // produces, a payload smaller than one part goes as a single put; a non empty sCodec is stored as
+    // "codec" metadata and Content-Encoding, ex: "gzip" for a payload downloadDecompressed inflates
+    bool uploadStream(const std::string& sBucket, const std::string& sObject, 
+                        const std::function<bool(const std::function<bool(std::string_view)>&)>& funProducer,
+                        const std::string& sCodec = "");
+    void setCheckpointOptions(const CheckpointOptions& stOptions);
+    // drop stale checkpoints with their partial files and server side uploads, return the count
+    int cleanupCheckpoints();
 
     void addTask(const std::string& sBucket, const std::string &sObject, const std::string &sSaveName, bool bDownload = true);
     void worker(bool bDownload = true);
     void start(int nNumThreads, bool bDownload = true);
+    // *InThread: pSummary receives the counters of this batch if given
     int downloadDirectoryInThread(const std::string& sBucket,
                         const std::string& sObject,
-                        const std::string& sLocalPath);
-    int downloadJsonListInThread(const std::string& sBucket, const std::vector<std::string> &vObjects, const std::string& sLocalPath);
+                        const std::string& sLocalPath,
+                        TransferSummary* pSummary = nullptr);
+    // download objects under sPrefix matching stFilter, transfers start while the listing continues
+    int downloadFilteredInThread(const std::string& sBucket,
+                        const std::string& sPrefix,
+                        const std::string& sLocalPath,
+                        const ObjectFilter& stFilter,
+                        TransferSummary* pSummary = nullptr);
+    int downloadJsonListInThread(const std::string& sBucket, const std::vector<std::string> &vObjects, const std::string& sLocalPath,
+                        TransferSummary* pSummary = nullptr);
     void cancelDownUp();
     int uploadDirectoryInThread(const std::string& sBucket,
                         const std::string& sObject,
                         const std::string& sLocalPath,
-                        bool bRecursive = false);
+                        bool bRecursive = false,
+                        TransferSummary* pSummary = nullptr);
 
-    int uploadJsonListInThread(const std::string& sBucket, std::unordered_map<std::string, std::string> &mapObjectKey, const std::string& sLocalPath);
+    void setPackOptions(const PackOptions& stOptions);
+    void setCompressionOptions(const CompressionOptions& stOptions);
+    // small files into "<sObject>/_pack/*.pack" plus "<sObject>/_pack/index", larger ones as usual
+    int uploadDirectoryPacked(const std::string& sBucket,
+                        const std::string& sObject,
+                        const std::string& sLocalPath,
+                        bool bRecursive = true);
+    // one GET per archive split into files, plus the unpacked objects under sObject
+    int downloadDirectoryPacked(const std::string& sBucket,
+                        const std::string& sObject,
+                        const std::string& sLocalPath);
+    bool loadPackIndex(const std::string& sBucket, const std::string& sObject, PackIndex& stIndex);
+    // one member by a ranged GET of its archive
+    bool readPackedFile(const std::string& sBucket, const std::string& sObject, const PackIndex& stIndex,
+                        const std::string& sName, std::string& sData);
+
+    int uploadJsonListInThread(const std::string& sBucket, std::unordered_map<std::string, std::string> &mapObjectKey, const std::string& sLocalPath,
+                        TransferSummary* pSummary = nullptr);
     bool setValid(bool bValid = true);
+    // applies to downloadDirectoryInThread and uploadDirectoryInThread
+    void setSyncOptions(const SyncOptions& stOptions);
+    void setVerifyOptions(const VerifyOptions& stOptions);
+    // ranks queued transfers, larger first; nullptr keeps the order tasks are added in
+    void setPriorityPolicy(std::function<int(const MinioTask&)> funPriority);
+    // tileset.json, then other json manifests, then tiles by path depth, shallow first
+    static int defaultPriority(const MinioTask& stTask);
+    // draw tokens from pLimiter as sJobId for every transfer of this manager, share one limiter
+    // between managers to shape them together, nullptr removes the limits
+    void setBandwidthLimiter(std::shared_ptr<BandwidthLimiter> pLimiter, const std::string& sJobId = "");
+    std::vector<JobThroughput> getThroughput() const;
+    // totals per bucket since construction, and the same as prometheus text for a /metrics handler
+    std::map<std::string, TransferSummary> getMetrics() const;
+    std::string metricsText() const;
+    // threads enumerating local directories for uploads
+    void setScanThreads(size_t nThreads);
+    // serve downloads from a local cache dir bounded by nMaxBytes, set before starting transfers
+    // bLinkTargets hard links downloads to the cached files, only if callers never modify them
+    void enableObjectCache(const std::string& sCacheDir, size_t nMaxBytes, bool bLinkTargets = false);
+    void disableObjectCache();
+    ObjectCacheStats getObjectCacheStats() const;
+    // download objects into the object cache in the background, a later download of one of them
+    // copies the cached file or joins its transfer; needs enableObjectCache, larger nPriority goes first
+    void prefetch(const std::string& sBucket, const std::vector<std::string>& vObjects, int nPriority = 0);
+    // prefetch the textures named by "comment TextureFile" in the header of a ply object, return the count
+    int prefetchPlyTextures(const std::string& sBucket, const std::string& sPlyObject);
+    // worker threads of the download/upload batches, each uses its own client, default 5
+    void setTransferThreads(size_t nThreads);
+    // background prefetch transfers, kept low so they do not crowd out blocking downloads
+    void setPrefetchThreads(size_t nThreads);
+    // bucket existence and object stat results are reused for stTtl, <= 0 disables
+    void setMetadataCacheTtl(std::chrono::milliseconds stTtl);
+    // forget cached metadata of sObject, or of the whole bucket if sObject is empty
+    void invalidateMetadata(const std::string& sBucket, const std::string& sObject = "");
 
 public:
     bool bucketExists(const std::string& sBucket);
     bool makeBucket(const std::string& sBucket);
 
+    // recursive listing handed out in pages of at most nPageSize matching items as the server returns them,
+    // return false from funOnPage to stop early, false if the listing failed
+    bool listObjectsPaged(const std::string& sBucket, const std::string& sPrefix, const ObjectFilter& stFilter,
+                        const std::function<bool(std::vector<minio::s3::Item>&)>& funOnPage, size_t nPageSize = 1000);
+    // recursive listing, filtered by m_stImageFilter if bImagesOnly, false if the listing failed
+    bool listObjectItems(const std::string& sBucket, const std::string& sPrefix, 
+                        std::vector<minio::s3::Item>& vItems, bool bImagesOnly = true);
+    bool isImageObject(const std::string& sName) const;
     std::vector<std::string> listFiles(const std::string &sLocalPath, const std::string& sPrefix = "", bool bRecursive = false);
 
     bool parseBrowserAddr(const std::string& sMinIOUrl);
 
     bool workerDownUp(const MinioTask& stTask, const std::atomic<bool>& bStopFlag);
 
+private:
+    minio::s3::Client& client() { return m_stClients.local(); }
+    // workerDownUp without the metrics
+    bool transferTask(const MinioTask& stTask, const std::atomic<bool>& bStopFlag);
+    // download sEtag of the object into the cache's temp file
+    bool downloadForCache(const std::string& sBucket, const std::string& sObject, const std::string& sTmpFile,
+                        size_t nSize, const std::string& sEtag);
+    bool prefetchTask(const MinioTask& stTask, const std::atomic<bool>& bStopFlag);
+    // through m_pObjectCache, sEtag/nSize are looked up if empty
+    bool downloadCached(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath, 
+                        size_t nSize, std::string sEtag);
+    bool uploadObjectMultipart(const std::string &sBucket, const std::string &sObject, const std::string &sLocalPathName, bool bAllowResume);
+    // abort the server side upload recorded in a multipart checkpoint
+    void abortCheckpointedUpload(const std::string& sCheckpointPath);
+    std::filesystem::path checkpointDir() const;
+    // checkpoint file of a transfer of sLocalPathName, szKind "multipart" or "ranged"
+    std::string checkpointPath(const std::string& sLocalPathName, const char* szKind) const;
+    // written beside a target while it transfers, ex: "<file>.ranged", never uploaded or synced
+    static bool isPartialFile(const std::string& sName);
+    bool shouldCompress(const std::string& sLocalPathName) const;
+    // gzip chunks streamed as multipart parts with codec metadata, no temp file
+    bool uploadCompressed(const std::string& sBucket, const std::string& sObject, const std::string& sLocalPathName);
+    // inflate while streaming, the target appears once complete
+    bool downloadDecompressed(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath);
+    // single PUT of an in-memory object
+    bool putBuffer(const std::string& sBucket, const std::string& sObject, std::string_view sData,
+                        const std::string& sCodec = "");
+    // multipart steps shared by file, buffer and stream uploads, sLabel names the source in logs
+    // sCrc32c of the whole payload is stored as user metadata if known up front
+    std::string createMultipart(const std::string& sBucket, const std::string& sObject, const std::string& sLabel,
+                        const std::string& sCrc32c = "", const std::string& sCodec = "");
+    bool uploadPart(const std::string& sBucket, const std::string& sObject, const std::string& sUploadId,
+                        unsigned int nPartNumber, std::string_view sData, const std::atomic<bool>& bStopFlag,
+                        const std::string& sLabel, std::string& sEtag, std::atomic<bool>& bNoSuchUpload);
+    bool completeMultipart(const std::string& sBucket, const std::string& sObject, const std::string& sUploadId,
+                        const std::vector<std::string>& vEtags, const std::string& sLabel, std::atomic<bool>& bNoSuchUpload);
+    void abortMultipart(const std::string& sBucket, const std::string& sObject, const std::string& sUploadId);
+    // set stTask.nPriority from m_funPriority
+    void prioritize(MinioTask& stTask) const;
+    // wait for bandwidth tokens, no-op without a limiter
+    void throttle(size_t nBytes);
+    // progressfunc for sdk calls that stream by themselves, throttles by the transferred delta
+    minio::http::ProgressFunction throttleProgress(bool bUpload);
+    // object size/etag, from m_stMetaCache if bUseCache
+    bool statObject(const std::string& sBucket, const std::string& sObject, ObjectMeta& stMeta, bool bUseCache = true);
+    // single GET pinned to sEtag into sSavePath, the bytes also go through pDigest if given
+    bool getObjectToFile(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath, const std::string& sEtag,
+                        TransferDigest* pDigest = nullptr);
+    // one attempt of downloadObjectRanged, bMismatch set if the bytes arrived but failed the checksum
+    bool downloadRangedOnce(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath, 
+                    const std::string& sExpectEtag, bool& bMismatch);
+    // getObjectToFile of the stMeta version checked against its checksum, retried on mismatch
+    bool getObjectVerified(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath, const ObjectMeta& stMeta);
+    // stat, then ranged or single verified download
+    bool downloadVerified(const std::string& sBucket, const std::string& sObject, const std::string& sSavePath);
+    bool checkDigest(const ObjectMeta& stMeta, TransferDigest& stDigest, const std::string& sObject) const;
+    // crc32c hex to tag an upload of the file with, empty if verification is off
+    std::string uploadChecksum(const std::string& sLocalPathName) const;
+
 private:
     bool m_bValid = true;
-    minio::s3::BaseUrl m_stBaseUrl;
-    minio::creds::StaticProvider m_stProvider;
-    minio::s3::Client m_stClient;
+    MultipartOptions m_stMultipartOptions;
+    RangedDownloadOptions m_stRangedOptions;
+    CheckpointOptions m_stCheckpointOptions;
+    PackOptions m_stPackOptions;
+    CompressionOptions m_stCompressOptions;
+    SyncOptions m_stSyncOptions;
+    VerifyOptions m_stVerifyOptions;
+    std::function<int(const MinioTask&)> m_funPriority = &MinIOManager::defaultPriority;
+    size_t m_nScanThreads = 8;
+    std::unique_ptr<ObjectCache> m_pObjectCache;
+    MetadataCache m_stMetaCache;
+    TransferMetrics m_stMetrics;
+    std::shared_ptr<BandwidthLimiter> m_pLimiter;
+    std::string m_sJobId;
+    // one client per thread, use client() rather than keeping references across threads
+    ClientPool m_stClients;
 
     std::mutex m_stMutexQueue;
     std::mutex m_stMutexCount;
     std::queue<std::pair<std::pair<std::string, std::string>, std::string> > m_quDownloadTask;
     std::queue<std::pair<std::pair<std::string, std::string>, std::string> > m_quUploadTask;
 
-    std::unordered_set<std::string> m_setImageExtensions = {
+    ObjectFilter m_stImageFilter = ObjectFilter::extensions({
         "jpg", "jpeg", "png", "gif", "bmp",
-    };
+    });
 
     TaskManager<MinioTask> stDownUpManager;
+
+    // created by the first prefetch, declared last to stop before everything its workers use;
+    // m_mutexPrefetch also guards swapping m_pObjectCache against a prefetch starting
+    size_t m_nPrefetchThreads = 2;
+    std::mutex m_mutexPrefetch;
+    std::unique_ptr<TaskManager<MinioTask> > m_pPrefetchManager;
 };
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+// local disk cache of downloaded objects, one file per bucket/object/etag under the cache dir
+// targets get a reflink (or a copy where the filesystem has none) of the cached file, a hard link
+// only with bLinkTargets, when callers never modify the files they receive
+// bounded by bytes with lru eviction, concurrent fetches of one object share one download
+
+struct ObjectCacheStats {
+    uint64_t nHits = 0;
+    uint64_t nMisses = 0;
+    uint64_t nJoined = 0;       // requests that waited on an in-flight download
+    uint64_t nPrefetched = 0;   // downloads started by warm()
+    uint64_t nEvictions = 0;
+    size_t nEntries = 0;
+    size_t nBytes = 0;
+};
+
+class ObjectCache {
+public:
+    // funDownload(sTmpFile) writes the object to sTmpFile, true on success
+    using DownloadFunc = std::function<bool(const std::string&)>;
+
+    ObjectCache(const std::string& sCacheDir, size_t nMaxBytes, bool bLinkTargets = false) 
+        : m_sCacheDir(sCacheDir), m_nMaxBytes(nMaxBytes), m_bLinkTargets(bLinkTargets) {
+        std::error_code ec;
+        std::filesystem::create_directories(m_sCacheDir, ec);
+        rebuildIndex();
+    }
+
+    ObjectCache(const ObjectCache&) = delete;
+    ObjectCache& operator = (const ObjectCache&) = delete;
+
+    // place the object at sTarget, from the cache or by one shared download, an empty sTarget only fills the cache
+    bool fetch(const std::string& sBucket, const std::string& sObject, const std::string& sEtag,
+                const std::string& sTarget, const DownloadFunc& funDownload) {
+        std::string sCacheFile = cacheFileOf(sBucket, sObject, sEtag);
+        std::shared_ptr<InFlight> pFlight;
+        bool bOwner = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto itr = m_mapEntries.find(sCacheFile);
+            if (itr != m_mapEntries.end()) {
+                if (sTarget.empty()) return true;
+                m_lsLru.splice(m_lsLru.begin(), m_lsLru, itr->second.itrLru);
+                ++m_stStats.nHits;
+                ++itr->second.nPins;
+                lock.unlock();
+                return materializePinned(sCacheFile, sTarget);
+            }
+            auto itrFlight = m_mapInFlight.find(sCacheFile);
+            if (itrFlight == m_mapInFlight.end()) {
+                pFlight = std::make_shared<InFlight>();
+                m_mapInFlight.insert({sCacheFile, pFlight});
+                bOwner = true;
+                if (sTarget.empty()) ++m_stStats.nPrefetched;
+                else ++m_stStats.nMisses;
+            } else {
+                // a prefetch never waits on another download
+                if (sTarget.empty()) return true;
+                pFlight = itrFlight->second;
+                ++m_stStats.nJoined;
+            }
+            if (!sTarget.empty()) ++pFlight->nPins;
+        }
+
+        if (bOwner) download(sCacheFile, pFlight, funDownload);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvInFlight.wait(lock, [&pFlight] { return pFlight->bDone; });
+        bool bRes = pFlight->bRes;
+        lock.unlock();
+        // pinned by download() on success, for the owner and every request that joined
+        if (!bRes || sTarget.empty()) return bRes;
+        return materializePinned(sCacheFile, sTarget);
+    }
+
+    // download into the cache only, true if cached or already on its way
+    bool warm(const std::string& sBucket, const std::string& sObject, const std::string& sEtag, const DownloadFunc& funDownload) {
+        return fetch(sBucket, sObject, sEtag, "", funDownload);
+    }
+
+    void setMaxBytes(size_t nMaxBytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_nMaxBytes = nMaxBytes;
+        evict();
+    }
+
+    // files being copied out stay until their copy is done
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto itr = m_lsLru.begin(); itr != m_lsLru.end(); ) {
+            auto itrEntry = m_mapEntries.find(*itr);
+            if (itrEntry->second.nPins > 0) {
+                ++itr;
+                continue;
+            }
+            std::error_code ec;
+            std::filesystem::remove(*itr, ec);
+            m_nBytes -= itrEntry->second.nSize;
+            m_mapEntries.erase(itrEntry);
+            itr = m_lsLru.erase(itr);
+        }
+    }
+
+    ObjectCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ObjectCacheStats stStats = m_stStats;
+        stStats.nEntries = m_mapEntries.size();
+        stStats.nBytes = m_nBytes;
+        return stStats;
+    }
+
+private:
+    struct Entry {
+        size_t nSize = 0;
+        std::list<std::string>::iterator itrLru;
+        size_t nPins = 0;       // materializing right now, not evictable
+    };
+
+    struct InFlight {
+        bool bDone = false;
+        bool bRes = false;
+        size_t nPins = 0;       // requests with a target, the entry is pinned for them on insert
+    };
+
+    std::string cacheFileOf(const std::string& sBucket, const std::string& sObject, std::string sEtag) const {
+        // etags come quoted from some servers
+        sEtag.erase(std::remove(sEtag.begin(), sEtag.end(), '"'), sEtag.end());
+        return m_sCacheDir + "/" + sBucket + "/" + sObject + "@" + sEtag;
+    }
+
+    // completes pFlight in the critical section that inserts the entry, pinned for every request
+    // that joined by then, so no eviction can come between the download and their copies
+    void download(const std::string& sCacheFile, const std::shared_ptr<InFlight>& pFlight, const DownloadFunc& funDownload) {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(sCacheFile).parent_path(), ec);
+        std::string sTmpFile = sCacheFile + ".part";
+        bool bRes = funDownload(sTmpFile);
+        size_t nSize = 0;
+        if (bRes) {
+            nSize = std::filesystem::file_size(sTmpFile, ec);
+            if (!ec) std::filesystem::rename(sTmpFile, sCacheFile, ec);
+            bRes = !ec;
+        }
+        if (!bRes) std::filesystem::remove(sTmpFile, ec);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (bRes) {
+            insert(sCacheFile, nSize, pFlight->nPins);
+            evict(sCacheFile);
+        }
+        pFlight->bDone = true;
+        pFlight->bRes = bRes;
+        m_mapInFlight.erase(sCacheFile);
+        m_cvInFlight.notify_all();
+    }
+
+    void insert(const std::string& sCacheFile, size_t nSize, size_t nPins = 0) {
+        auto itr = m_mapEntries.find(sCacheFile);
+        if (itr != m_mapEntries.end()) {
+            m_nBytes -= itr->second.nSize;
+            m_lsLru.erase(itr->second.itrLru);
+            m_mapEntries.erase(itr);
+        }
+        m_lsLru.push_front(sCacheFile);
+        m_mapEntries.insert({sCacheFile, {nSize, m_lsLru.begin(), nPins}});
+        m_nBytes += nSize;
+    }
+
+    // drop least recently used files until within budget, pinned ones and the just downloaded sKeep survive
+    void evict(const std::string& sKeep = "") {
+        auto itr = m_lsLru.end();
+        while (m_nBytes > m_nMaxBytes && itr != m_lsLru.begin()) {
+            --itr;
+            if (*itr == sKeep) continue;
+            auto itrEntry = m_mapEntries.find(*itr);
+            if (itrEntry->second.nPins > 0) continue;
+            m_nBytes -= itrEntry->second.nSize;
+            std::error_code ec;
+            std::filesystem::remove(*itr, ec);
+            m_mapEntries.erase(itrEntry);
+            itr = m_lsLru.erase(itr);
+            ++m_stStats.nEvictions;
+        }
+    }
+
+    // outside the lock on a pinned entry, a large copy must not hold up other cache users
+    bool materializePinned(const std::string& sCacheFile, const std::string& sTarget) {
+        bool bRes = materialize(sCacheFile, sTarget, m_bLinkTargets);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapEntries.find(sCacheFile);
+        if (itr != m_mapEntries.end()) --itr->second.nPins;
+        evict();
+        return bRes;
+    }
+
+    // hard link if allowed, reflink, then plain copy
+    static bool materialize(const std::string& sCacheFile, const std::string& sTarget, bool bLink) {
+        std::error_code ec;
+        std::filesystem::path fsTarget(sTarget);
+        if (fsTarget.has_parent_path()) std::filesystem::create_directories(fsTarget.parent_path(), ec);
+        std::filesystem::remove(fsTarget, ec);
+        if (bLink && link(sCacheFile.c_str(), sTarget.c_str()) == 0) return true;
+
+        int nSrc = open(sCacheFile.c_str(), O_RDONLY);
+        if (nSrc >= 0) {
+            int nDst = open(sTarget.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            bool bCloned = (nDst >= 0 && ioctl(nDst, FICLONE, nSrc) == 0);
+            if (nDst >= 0) close(nDst);
+            close(nSrc);
+            if (bCloned) return true;
+        }
+        return std::filesystem::copy_file(sCacheFile, sTarget, std::filesystem::copy_options::overwrite_existing, ec);
+    }
+
+    // pick up files left by a previous run, oldest first in lru order
+    void rebuildIndex() {
+        std::vector<std::pair<std::filesystem::file_time_type, std::string> > vFiles;
+        std::error_code ec;
+        for (auto itr = std::filesystem::recursive_directory_iterator(m_sCacheDir, ec);
+                !ec && itr != std::filesystem::recursive_directory_iterator(); itr.increment(ec)) {
+            if (!itr->is_regular_file()) continue;
+            std::string sFile = itr->path().string();
+            if (itr->path().extension() == ".part") {
+                std::filesystem::remove(itr->path(), ec);
+                continue;
+            }
+            // partial ranged downloads kept for resuming
+            if (itr->path().extension() == ".ranged" || itr->path().extension() == ".ckpt") continue;
+            vFiles.push_back({itr->last_write_time(), sFile});
+        }
+        std::sort(vFiles.begin(), vFiles.end());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& item : vFiles) {
+            insert(item.second, std::filesystem::file_size(item.second, ec));
+        }
+        evict();
+    }
+
+private:
+    std::string m_sCacheDir;
+    size_t m_nMaxBytes;
+    bool m_bLinkTargets;
+    size_t m_nBytes = 0;
+    // front is the most recently used cache file
+    std::list<std::string> m_lsLru;
+    std::unordered_map<std::string, Entry> m_mapEntries;
+    std::unordered_map<std::string, std::shared_ptr<InFlight> > m_mapInFlight;
+    std::condition_variable m_cvInFlight;
+    ObjectCacheStats m_stStats;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cctype>
+#include <ctime>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include <miniocpp/client.h>
+
+// predicate on listed objects, every field that is set must match
+
+struct ExtensionHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view sExt) const {
+        return std::hash<std::string_view>{}(sExt);
+    }
+};
+
+struct ObjectFilter {
+    std::unordered_set<std::string, ExtensionHash, std::equal_to<> > setExtensions;  // lowercase without dot, empty = any
+    size_t nMinSize = 0;
+    size_t nMaxSize = std::numeric_limits<size_t>::max();
+    std::time_t nModifiedAfter = 0;         // seconds since epoch, 0 = any
+    std::time_t nModifiedBefore = 0;
+    std::function<bool(const minio::s3::Item&)> funMatch;
+
+    static ObjectFilter extensions(std::initializer_list<std::string> lsExtensions) {
+        ObjectFilter stFilter;
+        stFilter.setExtensions.insert(lsExtensions.begin(), lsExtensions.end());
+        return stFilter;
+    }
+
+    // extension lookup without allocating, lowercased in a stack buffer
+    bool matchName(std::string_view sName) const {
+        if (setExtensions.empty()) return true;
+        size_t nDotPos = sName.find_last_of('.');
+        if (nDotPos == std::string_view::npos) return false;
+        std::string_view sExt = sName.substr(nDotPos + 1);
+        char szExt[16];
+        if (sExt.size() > sizeof(szExt)) return false;
+        for (size_t i = 0; i < sExt.size(); ++i) {
+            szExt[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(sExt[i])));
+        }
+        return setExtensions.find(std::string_view(szExt, sExt.size())) != setExtensions.end();
+    }
+
+    bool match(const minio::s3::Item& item) const {
+        if (item.is_prefix || item.size < nMinSize || item.size > nMaxSize) return false;
+        if (!matchName(item.name)) return false;
+        if (nModifiedAfter > 0 || nModifiedBefore > 0) {
+            std::time_t nModified = item.last_modified.SecondsSinceEpoch();
+            if (nModifiedAfter > 0 && nModified <= nModifiedAfter) return false;
+            if (nModifiedBefore > 0 && nModified >= nModifiedBefore) return false;
+        }
+        return !funMatch || funMatch(item);
+    }
+};
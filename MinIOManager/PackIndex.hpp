@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// index of small files packed into archive objects under "<prefix>/_pack/"
+// archives are plain concatenations, the index object has one line per member:
+// "<archive number> <offset> <length> <relative path>"
+
+struct PackMember {
+    uint32_t nArchive = 0;
+    size_t nOffset = 0;
+    size_t nLength = 0;
+};
+
+class PackIndex {
+public:
+    static constexpr const char* kPackDir = "_pack/";
+
+    static std::string indexName() { return std::string(kPackDir) + "index"; }
+
+    static std::string archiveName(uint32_t nArchive) {
+        char szName[32];
+        std::snprintf(szName, sizeof(szName), "%06u.pack", nArchive);
+        return std::string(kPackDir) + szName;
+    }
+
+    void add(const std::string& sName, const PackMember& stMember) {
+        m_mapMembers[sName] = stMember;
+        m_nArchives = std::max(m_nArchives, stMember.nArchive + 1);
+    }
+
+    const PackMember* find(const std::string& sName) const {
+        auto itr = m_mapMembers.find(sName);
+        return (itr == m_mapMembers.end() ? nullptr : &itr->second);
+    }
+
+    // members of nArchive in file order
+    std::vector<std::pair<std::string, PackMember> > archiveMembers(uint32_t nArchive) const {
+        std::vector<std::pair<std::string, PackMember> > vMembers;
+        for (const auto& item : m_mapMembers) {
+            if (item.second.nArchive == nArchive) vMembers.push_back(item);
+        }
+        std::sort(vMembers.begin(), vMembers.end(), [](const auto& a, const auto& b) {
+            return a.second.nOffset < b.second.nOffset;
+        });
+        return vMembers;
+    }
+
+    std::string serialize() const {
+        std::ostringstream ssOut;
+        for (const auto& item : m_mapMembers) {
+            ssOut << item.second.nArchive << ' ' << item.second.nOffset << ' ' << item.second.nLength << ' ' << item.first << '\n';
+        }
+        return ssOut.str();
+    }
+
+    bool parse(const std::string& sData) {
+        clear();
+        std::istringstream ssIn(sData);
+        PackMember stMember;
+        std::string sName;
+        while (ssIn >> stMember.nArchive >> stMember.nOffset >> stMember.nLength) {
+            ssIn.get();
+            if (!std::getline(ssIn, sName)) return false;
+            add(sName, stMember);
+        }
+        return ssIn.eof();
+    }
+
+    void clear() {
+        m_mapMembers.clear();
+        m_nArchives = 0;
+    }
+
+    size_t size() const { return m_mapMembers.size(); }
+    uint32_t archiveCount() const { return m_nArchives; }
+    const std::unordered_map<std::string, PackMember>& members() const { return m_mapMembers; }
+
+private:
+    std::unordered_map<std::string, PackMember> m_mapMembers;
+    uint32_t m_nArchives = 0;
+};
@@ -0,0 +1,435 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "httplib.h"
+#include "Checksum.hpp"
+
+// in-process s3 lookalike for benchmarks, just enough of the api for minio-cpp and MinIOManager:
+// bucket head/create/location, ListObjectsV2 with pages, object HEAD/GET (ranges, If-Match),
+// PUT, DELETE and multipart uploads; requests are not authenticated, objects live in memory
+
+struct StandInOptions {
+    int nLatencyMs = 0;             // added before every request is handled
+    size_t nBandwidth = 0;          // bytes/s of each request or response body, 0 unlimited
+    double dErrorRate = 0.0;        // share of requests answered 503 SlowDown
+    size_t nThreads = 16;           // connections served at once
+    uint32_t nSeed = 1;
+};
+
+struct StandInStats {
+    size_t nRequests = 0;
+    size_t nInjectedErrors = 0;
+    size_t nBytesIn = 0;
+    size_t nBytesOut = 0;
+};
+
+class S3StandIn {
+public:
+    explicit S3StandIn(const StandInOptions& stOptions = StandInOptions())
+        : m_stOptions(stOptions), m_stRandom(stOptions.nSeed) {
+        setupRoutes();
+    }
+
+    ~S3StandIn() {
+        stop();
+    }
+
+    S3StandIn(const S3StandIn&) = delete;
+    S3StandIn& operator = (const S3StandIn&) = delete;
+
+    // nPort 0 picks a free port, return the port or -1
+    int start(const std::string& sHost = "127.0.0.1", int nPort = 0) {
+        m_nPort = (nPort == 0 ? m_stServer.bind_to_any_port(sHost) : (m_stServer.bind_to_port(sHost, nPort) ? nPort : -1));
+        if (m_nPort < 0) return -1;
+        m_sHost = sHost;
+        m_thServer = std::thread([this] { m_stServer.listen_after_bind(); });
+        m_stServer.wait_until_ready();
+        return m_nPort;
+    }
+
+    void stop() {
+        m_stServer.stop();
+        if (m_thServer.joinable()) m_thServer.join();
+    }
+
+    // "host:port" for MinIOManager / minio::s3::BaseUrl
+    std::string endpoint() const { return m_sHost + ":" + std::to_string(m_nPort); }
+
+    // fault injection may change while serving
+    void setOptions(const StandInOptions& stOptions) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stOptions.nLatencyMs = stOptions.nLatencyMs;
+        m_stOptions.nBandwidth = stOptions.nBandwidth;
+        m_stOptions.dErrorRate = stOptions.dErrorRate;
+    }
+
+    StandInStats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stStats;
+    }
+
+    // seeding without going through http
+    void makeBucket(const std::string& sBucket) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapBuckets[sBucket];
+    }
+
+    void putObject(const std::string& sBucket, const std::string& sKey, std::string sData) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapBuckets[sBucket][sKey] = makeObject(std::move(sData), {});
+    }
+
+    bool hasObject(const std::string& sBucket, const std::string& sKey) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapBuckets.find(sBucket);
+        return itr != m_mapBuckets.end() && itr->second.count(sKey) > 0;
+    }
+
+private:
+    struct StoredObject {
+        std::shared_ptr<const std::string> pData;
+        std::string sEtag;          // without quotes
+        time_t nMTime = 0;
+        std::map<std::string, std::string> mapMeta;     // lowercase "x-amz-meta-*" headers
+    };
+
+    struct Upload {
+        std::string sBucket;
+        std::string sKey;
+        std::map<std::string, std::string> mapMeta;
+        std::map<int, std::pair<std::string, std::string> > mapParts;  // number -> (etag, data)
+    };
+
+    using Bucket = std::map<std::string, StoredObject>;
+
+    static StoredObject makeObject(std::string sData, std::map<std::string, std::string> mapMeta, std::string sEtag = "") {
+        StoredObject stObject;
+        if (sEtag.empty()) {
+            Md5Stream stMd5;
+            stMd5.update(sData.data(), sData.size());
+            sEtag = stMd5.finalHex();
+        }
+        stObject.sEtag = std::move(sEtag);
+        stObject.pData = std::make_shared<const std::string>(std::move(sData));
+        stObject.nMTime = std::time(nullptr);
+        stObject.mapMeta = std::move(mapMeta);
+        return stObject;
+    }
+
+    static std::string xmlEscape(const std::string& sText) {
+        std::string sRes;
+        sRes.reserve(sText.size());
+        for (char c : sText) {
+            switch (c) {
+                case '&': sRes += "&amp;"; break;
+                case '<': sRes += "&lt;"; break;
+                case '>': sRes += "&gt;"; break;
+                case '"': sRes += "&quot;"; break;
+                default: sRes += c;
+            }
+        }
+        return sRes;
+    }
+
+    static std::string formatTime(time_t nTime, const char* szFormat) {
+        struct tm stTm;
+        gmtime_r(&nTime, &stTm);
+        char szBuf[64];
+        std::strftime(szBuf, sizeof(szBuf), szFormat, &stTm);
+        return szBuf;
+    }
+
+    static std::string stripQuotes(std::string sEtag) {
+        for (const char* szQuote : {"&quot;", "\""}) {
+            size_t nPos;
+            while ((nPos = sEtag.find(szQuote)) != std::string::npos) sEtag.erase(nPos, std::strlen(szQuote));
+        }
+        return sEtag;
+    }
+
+    static void sendError(httplib::Response& res, int nStatus, const std::string& sCode, const std::string& sResource) {
+        res.status = nStatus;
+        res.set_content("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Error><Code>" + sCode + "</Code><Message>" + sCode
+            + "</Message><Resource>" + xmlEscape(sResource) + "</Resource><RequestId>standin</RequestId></Error>", "application/xml");
+    }
+
+    static std::map<std::string, std::string> userMetadata(const httplib::Request& req) {
+        std::map<std::string, std::string> mapMeta;
+        for (const auto& item : req.headers) {
+            std::string sName = item.first;
+            std::transform(sName.begin(), sName.end(), sName.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (sName.rfind("x-amz-meta-", 0) == 0) mapMeta[sName] = item.second;
+        }
+        return mapMeta;
+    }
+
+    // sleep as if nBytes went through a link of nBandwidth bytes/s
+    void pace(size_t nBytes) const {
+        size_t nBandwidth = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            nBandwidth = m_stOptions.nBandwidth;
+        }
+        if (nBandwidth == 0 || nBytes == 0) return;
+        std::this_thread::sleep_for(std::chrono::microseconds(nBytes * 1000000 / nBandwidth));
+    }
+
+    void setupRoutes() {
+        size_t nThreads = std::max<size_t>(m_stOptions.nThreads, 1);
+        m_stServer.new_task_queue = [nThreads] { return new httplib::ThreadPool(nThreads); };
+
+        m_stServer.set_pre_routing_handler([this](const httplib::Request& req, httplib::Response& res) {
+            int nLatencyMs = 0;
+            bool bFail = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_stStats.nRequests;
+                nLatencyMs = m_stOptions.nLatencyMs;
+                bFail = (m_stOptions.dErrorRate > 0 && std::uniform_real_distribution<double>(0, 1)(m_stRandom) < m_stOptions.dErrorRate);
+                if (bFail) ++m_stStats.nInjectedErrors;
+            }
+            if (nLatencyMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(nLatencyMs));
+            if (!bFail) return httplib::Server::HandlerResponse::Unhandled;
+            sendError(res, 503, "SlowDown", req.path);
+            return httplib::Server::HandlerResponse::Handled;
+        });
+
+        // bucket level, HEAD is served by the GET handler without a body
+        m_stServer.Get(R"(/([^/]+)/?)", [this](const httplib::Request& req, httplib::Response& res) {
+            handleBucketGet(req, res);
+        });
+        m_stServer.Put(R"(/([^/]+)/?)", [this](const httplib::Request& req, httplib::Response& res) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_mapBuckets[req.matches[1]];
+            res.status = 200;
+        });
+
+        m_stServer.Get(R"(/([^/]+)/(.+))", [this](const httplib::Request& req, httplib::Response& res) {
+            handleObjectGet(req, res);
+        });
+        m_stServer.Put(R"(/([^/]+)/(.+))", [this](const httplib::Request& req, httplib::Response& res) {
+            handleObjectPut(req, res);
+        });
+        m_stServer.Post(R"(/([^/]+)/(.+))", [this](const httplib::Request& req, httplib::Response& res) {
+            handleObjectPost(req, res);
+        });
+        m_stServer.Delete(R"(/([^/]+)/(.+))", [this](const httplib::Request& req, httplib::Response& res) {
+            std::string sBucket = req.matches[1];
+            std::string sKey = req.matches[2];
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (req.has_param("uploadId")) m_mapUploads.erase(req.get_param_value("uploadId"));
+            else if (m_mapBuckets.count(sBucket)) m_mapBuckets[sBucket].erase(sKey);
+            res.status = 204;
+        });
+    }
+
+    void handleBucketGet(const httplib::Request& req, httplib::Response& res) {
+        std::string sBucket = req.matches[1];
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itrBucket = m_mapBuckets.find(sBucket);
+        if (itrBucket == m_mapBuckets.end()) {
+            sendError(res, 404, "NoSuchBucket", req.path);
+            return;
+        }
+        if (req.has_param("location")) {
+            res.set_content("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<LocationConstraint xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">us-east-1</LocationConstraint>", "application/xml");
+            return;
+        }
+        if (req.method == "HEAD") return;
+
+        // ListObjectsV2, continuation token is the last key of the previous page
+        std::string sPrefix = req.get_param_value("prefix");
+        std::string sDelimiter = req.get_param_value("delimiter");
+        std::string sAfter = req.has_param("continuation-token") ? req.get_param_value("continuation-token")
+                                                                  : req.get_param_value("start-after");
+        size_t nMaxKeys = 1000;
+        if (req.has_param("max-keys")) nMaxKeys = std::min<size_t>(std::max(std::stoul(req.get_param_value("max-keys")), 1ul), 1000);
+
+        std::string sContents;
+        std::string sPrefixes;
+        std::string sLastCommon;
+        size_t nCount = 0;
+        std::string sLastKey;
+        bool bTruncated = false;
+        const Bucket& mapObjects = itrBucket->second;
+        auto itr = (sAfter.empty() ? mapObjects.lower_bound(sPrefix) : mapObjects.upper_bound(sAfter));
+        for (; itr != mapObjects.end() && itr->first.compare(0, sPrefix.size(), sPrefix) == 0; ++itr) {
+            if (nCount == nMaxKeys) {
+                bTruncated = true;
+                break;
+            }
+            const std::string& sKey = itr->first;
+            size_t nDelim = (sDelimiter.empty() ? std::string::npos : sKey.find(sDelimiter, sPrefix.size()));
+            if (nDelim != std::string::npos) {
+                std::string sCommon = sKey.substr(0, nDelim + sDelimiter.size());
+                if (sCommon == sLastCommon) continue;
+                sLastCommon = sCommon;
+                sPrefixes += "<CommonPrefixes><Prefix>" + xmlEscape(sCommon) + "</Prefix></CommonPrefixes>";
+            } else {
+                const StoredObject& stObject = itr->second;
+                sContents += "<Contents><Key>" + xmlEscape(sKey) + "</Key><LastModified>"
+                    + formatTime(stObject.nMTime, "%Y-%m-%dT%H:%M:%S.000Z") + "</LastModified><ETag>&quot;"
+                    + stObject.sEtag + "&quot;</ETag><Size>" + std::to_string(stObject.pData->size())
+                    + "</Size><StorageClass>STANDARD</StorageClass></Contents>";
+            }
+            sLastKey = sKey;
+            ++nCount;
+        }
+        std::string sXml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<ListBucketResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\"><Name>" + xmlEscape(sBucket)
+            + "</Name><Prefix>" + xmlEscape(sPrefix) + "</Prefix><KeyCount>" + std::to_string(nCount)
+            + "</KeyCount><MaxKeys>" + std::to_string(nMaxKeys) + "</MaxKeys>";
+        if (!sDelimiter.empty()) sXml += "<Delimiter>" + xmlEscape(sDelimiter) + "</Delimiter>";
+        sXml += std::string("<IsTruncated>") + (bTruncated ? "true" : "false") + "</IsTruncated>";
+        if (bTruncated) sXml += "<NextContinuationToken>" + xmlEscape(sLastKey) + "</NextContinuationToken>";
+        sXml += sContents + sPrefixes + "</ListBucketResult>";
+        res.set_content(sXml, "application/xml");
+    }
+
+    void handleObjectGet(const httplib::Request& req, httplib::Response& res) {
+        std::string sBucket = req.matches[1];
+        std::string sKey = req.matches[2];
+        StoredObject stObject;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto itrBucket = m_mapBuckets.find(sBucket);
+            if (itrBucket == m_mapBuckets.end()) {
+                sendError(res, 404, "NoSuchBucket", req.path);
+                return;
+            }
+            auto itr = itrBucket->second.find(sKey);
+            if (itr == itrBucket->second.end()) {
+                sendError(res, 404, "NoSuchKey", req.path);
+                return;
+            }
+            stObject = itr->second;
+        }
+        if (req.has_header("If-Match") && stripQuotes(req.get_header_value("If-Match")) != stObject.sEtag) {
+            sendError(res, 412, "PreconditionFailed", req.path);
+            return;
+        }
+        res.set_header("ETag", "\"" + stObject.sEtag + "\"");
+        res.set_header("Last-Modified", formatTime(stObject.nMTime, "%a, %d %b %Y %H:%M:%S GMT"));
+        res.set_header("Accept-Ranges", "bytes");
+        for (const auto& item : stObject.mapMeta) res.set_header(item.first, item.second);
+        // httplib cuts Range requests out of the provider and answers 206
+        auto pData = stObject.pData;
+        res.set_content_provider(pData->size(), "application/octet-stream",
+            [this, pData](size_t nOffset, size_t nLength, httplib::DataSink& sink) {
+            size_t nChunk = std::min<size_t>(nLength, 64 << 10);
+            pace(nChunk);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stStats.nBytesOut += nChunk;
+            }
+            return sink.write(pData->data() + nOffset, nChunk);
+        });
+    }
+
+    void handleObjectPut(const httplib::Request& req, httplib::Response& res) {
+        std::string sBucket = req.matches[1];
+        std::string sKey = req.matches[2];
+        pace(req.body.size());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stStats.nBytesIn += req.body.size();
+        if (!m_mapBuckets.count(sBucket)) {
+            sendError(res, 404, "NoSuchBucket", req.path);
+            return;
+        }
+        if (req.has_param("uploadId")) {
+            auto itr = m_mapUploads.find(req.get_param_value("uploadId"));
+            if (itr == m_mapUploads.end()) {
+                sendError(res, 404, "NoSuchUpload", req.path);
+                return;
+            }
+            Md5Stream stMd5;
+            stMd5.update(req.body.data(), req.body.size());
+            std::string sEtag = stMd5.finalHex();
+            itr->second.mapParts[std::stoi(req.get_param_value("partNumber"))] = {sEtag, req.body};
+            res.set_header("ETag", "\"" + sEtag + "\"");
+            return;
+        }
+        StoredObject stObject = makeObject(req.body, userMetadata(req));
+        res.set_header("ETag", "\"" + stObject.sEtag + "\"");
+        m_mapBuckets[sBucket][sKey] = std::move(stObject);
+    }
+
+    void handleObjectPost(const httplib::Request& req, httplib::Response& res) {
+        std::string sBucket = req.matches[1];
+        std::string sKey = req.matches[2];
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_mapBuckets.count(sBucket)) {
+            sendError(res, 404, "NoSuchBucket", req.path);
+            return;
+        }
+        if (req.has_param("uploads")) {
+            std::string sUploadId = std::to_string(++m_nUploadSeq) + "-" + std::to_string(m_stRandom());
+            m_mapUploads[sUploadId] = {sBucket, sKey, userMetadata(req), {}};
+            res.set_content("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<InitiateMultipartUploadResult><Bucket>" + xmlEscape(sBucket)
+                + "</Bucket><Key>" + xmlEscape(sKey) + "</Key><UploadId>" + sUploadId + "</UploadId></InitiateMultipartUploadResult>",
+                "application/xml");
+            return;
+        }
+        auto itr = m_mapUploads.find(req.get_param_value("uploadId"));
+        if (itr == m_mapUploads.end()) {
+            sendError(res, 404, "NoSuchUpload", req.path);
+            return;
+        }
+        // "<Part><PartNumber>n</PartNumber><ETag>e</ETag></Part>" in order
+        std::string sData;
+        std::string sMd5s;
+        size_t nParts = 0;
+        size_t nPos = 0;
+        while ((nPos = req.body.find("<PartNumber>", nPos)) != std::string::npos) {
+            int nPart = std::atoi(req.body.c_str() + nPos + 12);
+            size_t nEtag = req.body.find("<ETag>", nPos);
+            size_t nEtagEnd = req.body.find("</ETag>", nEtag);
+            if (nEtag == std::string::npos || nEtagEnd == std::string::npos) break;
+            std::string sEtag = stripQuotes(req.body.substr(nEtag + 6, nEtagEnd - nEtag - 6));
+            auto itrPart = itr->second.mapParts.find(nPart);
+            if (itrPart == itr->second.mapParts.end() || itrPart->second.first != sEtag) {
+                sendError(res, 400, "InvalidPart", req.path);
+                return;
+            }
+            sData += itrPart->second.second;
+            for (size_t i = 0; i + 1 < sEtag.size(); i += 2) sMd5s += static_cast<char>(std::stoi(sEtag.substr(i, 2), nullptr, 16));
+            ++nParts;
+            nPos = nEtagEnd;
+        }
+        // s3 style etag of a multipart object: md5 of the part md5s, "-<parts>"
+        Md5Stream stMd5;
+        stMd5.update(sMd5s.data(), sMd5s.size());
+        std::string sEtag = stMd5.finalHex() + "-" + std::to_string(nParts);
+        m_mapBuckets[sBucket][sKey] = makeObject(std::move(sData), itr->second.mapMeta, sEtag);
+        m_mapUploads.erase(itr);
+        res.set_content("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<CompleteMultipartUploadResult><Bucket>" + xmlEscape(sBucket)
+            + "</Bucket><Key>" + xmlEscape(sKey) + "</Key><ETag>&quot;" + sEtag + "&quot;</ETag></CompleteMultipartUploadResult>",
+            "application/xml");
+    }
+
+private:
+    StandInOptions m_stOptions;
+    httplib::Server m_stServer;
+    std::thread m_thServer;
+    std::string m_sHost;
+    int m_nPort = -1;
+
+    mutable std::mutex m_mutex;
+    std::mt19937 m_stRandom;
+    StandInStats m_stStats;
+    std::unordered_map<std::string, Bucket> m_mapBuckets;
+    std::unordered_map<std::string, Upload> m_mapUploads;
+    size_t m_nUploadSeq = 0;
+};
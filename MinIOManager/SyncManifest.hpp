@@ -0,0 +1,80 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+// state of files last synced between a local directory and a bucket prefix, saved in the directory
+// one entry per line: "<size> <mtime> <etag> <relative path>"
+
+struct SyncEntry {
+    size_t nSize = 0;
+    long long nMTime = 0;       // local file_time_type ticks when synced
+    std::string sEtag;          // remote etag when synced, "-" if unknown
+};
+
+class SyncManifest {
+public:
+    bool load(const std::string& sPath) {
+        m_sPath = sPath;
+        m_mapEntries.clear();
+        std::ifstream fsIn(sPath);
+        if (!fsIn.is_open()) return false;
+        SyncEntry stEntry;
+        std::string sName;
+        while (fsIn >> stEntry.nSize >> stEntry.nMTime >> stEntry.sEtag) {
+            fsIn.get();
+            if (!std::getline(fsIn, sName)) break;
+            m_mapEntries[sName] = stEntry;
+        }
+        return true;
+    }
+
+    bool save() const {
+        if (m_sPath.empty()) return false;
+        std::string sTmpPath = m_sPath + ".tmp";
+        {
+            std::ofstream fsOut(sTmpPath, std::ios::trunc);
+            if (!fsOut.is_open()) return false;
+            for (const auto& item : m_mapEntries) {
+                fsOut << item.second.nSize << ' ' << item.second.nMTime << ' '
+                    << (item.second.sEtag.empty() ? "-" : item.second.sEtag) << ' ' << item.first << '\n';
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(sTmpPath, m_sPath, ec);
+        return !ec;
+    }
+
+    const SyncEntry* find(const std::string& sName) const {
+        auto itr = m_mapEntries.find(sName);
+        return (itr == m_mapEntries.end() ? nullptr : &itr->second);
+    }
+
+    void update(const std::string& sName, const SyncEntry& stEntry) { m_mapEntries[sName] = stEntry; }
+    void erase(const std::string& sName) { m_mapEntries.erase(sName); }
+
+    // current size and mtime of a local file, false if it does not exist
+    static bool localState(const std::string& sFile, SyncEntry& stEntry) {
+        std::error_code ec;
+        stEntry.nSize = std::filesystem::file_size(sFile, ec);
+        if (ec) return false;
+        stEntry.nMTime = std::filesystem::last_write_time(sFile, ec).time_since_epoch().count();
+        return !ec;
+    }
+
+    // unchanged since last sync: same local size/mtime and, if given, same remote etag
+    bool unchanged(const std::string& sName, const std::string& sFile, const std::string& sEtag = "") const {
+        const SyncEntry* pEntry = find(sName);
+        if (pEntry == nullptr) return false;
+        SyncEntry stLocal;
+        if (!localState(sFile, stLocal)) return false;
+        if (stLocal.nSize != pEntry->nSize || stLocal.nMTime != pEntry->nMTime) return false;
+        return sEtag.empty() || sEtag == pEntry->sEtag;
+    }
+
+private:
+    std::string m_sPath;
+    std::unordered_map<std::string, SyncEntry> m_mapEntries;
+};
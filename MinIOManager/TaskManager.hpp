@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
 #include <thread>
 #include <vector>
 
 // for fix count tasks, ex: download/upload files in folder
+// a Task with an nPriority member is taken highest first, equal priorities in the order added
+// workers exit once a batch completes, the next start() brings the pool back to its thread count
 
 template<typename Task>
 class TaskManager {
@@ -23,23 +30,66 @@ public:
     }
 
     void addTask(const Task& stTask) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quTasks.push({priorityOf(stTask), m_nSeq++, stTask});
+            ++m_nRemainTasks;
+        }
+        m_cvStop.notify_one();
+    }
+
+    void addTasks(const std::vector<Task>& vTasks) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto &stTask : vTasks) {
+                m_quTasks.push({priorityOf(stTask), m_nSeq++, stTask});
+                ++m_nRemainTasks;
+            }
+        }
+        m_cvStop.notify_all();
+    }
+
+    // hold workers and waitForComplete while a producer still adds tasks after start()
+    void beginFeed() {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_quTasks.push(stTask);
         ++m_nRemainTasks;
     }
 
-    void addTasks(const std::vector<Task>& vTasks) {
+    void endFeed() {
         std::lock_guard<std::mutex> lock(m_mutex);
-        for (const auto &stTask : vTasks) {
-            m_quTasks.push(stTask);
-            ++m_nRemainTasks;
+        --m_nRemainTasks;
+        if (m_nRemainTasks == 0 && m_quTasks.empty()) {
+            m_cvDone.notify_all();
+            m_cvStop.notify_all();
         }
     }
 
+    // worker count of the next start()
+    void setThreadCount(size_t nNumThreads) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_nNumThreads = nNumThreads;
+    }
+
+    // top up to the thread count, workers still busy with an earlier batch are counted
     void start() {
-        for (size_t i = 0; i < m_nNumThreads; ++i) {
-            m_vWorkers.emplace_back(&TaskManager::workerFunc, this);
+        std::vector<std::thread> vExited;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto itr = m_vWorkers.begin(); itr != m_vWorkers.end(); ) {
+                if (std::find(m_vExitedIds.begin(), m_vExitedIds.end(), itr->get_id()) == m_vExitedIds.end()) {
+                    ++itr;
+                    continue;
+                }
+                vExited.push_back(std::move(*itr));
+                itr = m_vWorkers.erase(itr);
+            }
+            m_vExitedIds.clear();
+            for (; m_nLiveWorkers < m_nNumThreads; ++m_nLiveWorkers) {
+                m_vWorkers.emplace_back(&TaskManager::workerFunc, this);
+            }
         }
+        // already returned or about to
+        for (auto &th : vExited) th.join();
     }
 
     void waitForComplete() {
@@ -49,6 +99,14 @@ public:
         });
     }
 
+    // tasks whose TaskFunc returned false since the last call
+    std::vector<Task> takeFailedTasks() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Task> vFailed;
+        vFailed.swap(m_vFailedTasks);
+        return vFailed;
+    }
+
     void stop() {
         {
             std::unique_lock<std::mutex> lock(m_mutex);
@@ -61,26 +119,50 @@ public:
             if (th.joinable()) th.join();
         }
         m_vWorkers.clear();
+        m_vExitedIds.clear();
     }
 
 private:
+    struct QueuedTask {
+        int nPriority;
+        uint64_t nSeq;
+        Task stTask;
+    };
+
+    // top of the heap: highest priority, then earliest added
+    struct QueuedOrder {
+        bool operator()(const QueuedTask& a, const QueuedTask& b) const {
+            if (a.nPriority != b.nPriority) return a.nPriority < b.nPriority;
+            return a.nSeq > b.nSeq;
+        }
+    };
+
+    static int priorityOf(const Task& stTask) {
+        if constexpr (requires { stTask.nPriority; }) return static_cast<int>(stTask.nPriority);
+        else return 0;
+    }
+
     void workerFunc() {
         while (true) {
             Task stTask;
             bool bHasTask = false;
             {
                 std::unique_lock<std::mutex> lock(m_mutex);
-                m_cvStop.wait(lock, [this] { return !m_quTasks.empty() || m_bStop; });
+                m_cvStop.wait(lock, [this] { return !m_quTasks.empty() || m_bStop || m_nRemainTasks == 0; });
             
                 if (m_bStop) {
                     while (!m_quTasks.empty()) m_quTasks.pop();
+                    exitLocked();
                     break;
                 }
-                if (!m_quTasks.empty()) {
-                    stTask = m_quTasks.front();
-                    m_quTasks.pop();
-                    bHasTask = true;
+                // batch complete, idle workers leave with the last one
+                if (m_quTasks.empty()) {
+                    exitLocked();
+                    break;
                 }
+                stTask = m_quTasks.top().stTask;
+                m_quTasks.pop();
+                bHasTask = true;
             }
 
             if (bHasTask) {
@@ -88,9 +170,12 @@ private:
 
                 {
                     std::lock_guard<std::mutex> lock(m_mutex);
+                    if (!bSuccess) m_vFailedTasks.push_back(stTask);
                     --m_nRemainTasks;
                     if (m_nRemainTasks == 0 && m_quTasks.empty()) {
+                        exitLocked();
                         m_cvDone.notify_all();
+                        m_cvStop.notify_all();
                         break;
                     }
                 }
@@ -98,12 +183,23 @@ private:
         }
     }
 
+    // under m_mutex where the worker decides to leave, a start() after waitForComplete() must not count it
+    void exitLocked() {
+        --m_nLiveWorkers;
+        m_vExitedIds.push_back(std::this_thread::get_id());
+    }
+
 private:
     size_t m_nNumThreads;
     std::atomic<size_t> m_nRemainTasks;
     mutable std::mutex m_mutex;
     std::vector<std::thread> m_vWorkers;
-    std::queue<Task> m_quTasks;
+    size_t m_nLiveWorkers = 0;
+    // workers that returned, joined by the next start()
+    std::vector<std::thread::id> m_vExitedIds;
+    std::priority_queue<QueuedTask, std::vector<QueuedTask>, QueuedOrder> m_quTasks;
+    uint64_t m_nSeq = 0;
+    std::vector<Task> m_vFailedTasks;
     std::condition_variable m_cvDone;
     std::condition_variable m_cvStop;
     std::atomic<bool> m_bStop;
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// sidecar file of a resumable transfer: a header line naming the transfer (object version, sizes),
+// then one line per completed unit appended as it completes, ex: range index, part number + etag
+
+class TransferCheckpoint {
+public:
+    explicit TransferCheckpoint(const std::string& sPath) : m_sPath(sPath) {}
+
+    TransferCheckpoint(const TransferCheckpoint&) = delete;
+    TransferCheckpoint& operator = (const TransferCheckpoint&) = delete;
+
+    const std::string& path() const { return m_sPath; }
+
+    // completed lines if the file belongs to sHeader and is not older than nStaleSeconds
+    bool load(const std::string& sHeader, std::vector<std::string>& vLines, int64_t nStaleSeconds) const {
+        if (isStale(m_sPath, nStaleSeconds)) return false;
+        std::ifstream fsIn(m_sPath);
+        std::string sLine;
+        if (!std::getline(fsIn, sLine) || sLine != sHeader) return false;
+        vLines.clear();
+        while (std::getline(fsIn, sLine)) {
+            // a crash may cut the last line, every complete line ends with '\n'
+            if (fsIn.eof()) break;
+            vLines.push_back(sLine);
+        }
+        return true;
+    }
+
+    // start over for sHeader
+    bool begin(const std::string& sHeader) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fsOut.close();
+        m_fsOut.open(m_sPath, std::ios::trunc);
+        if (!m_fsOut.is_open()) return false;
+        m_fsOut << sHeader << '\n';
+        m_fsOut.flush();
+        return m_fsOut.good();
+    }
+
+    // continue a loaded checkpoint
+    bool resume() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fsOut.close();
+        m_fsOut.open(m_sPath, std::ios::app);
+        return m_fsOut.is_open();
+    }
+
+    void append(const std::string& sLine) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_fsOut.is_open()) return;
+        m_fsOut << sLine << '\n';
+        m_fsOut.flush();
+    }
+
+    void remove() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fsOut.close();
+        std::error_code ec;
+        std::filesystem::remove(m_sPath, ec);
+    }
+
+    // first nLines lines of any checkpoint file, for cleanup
+    static std::vector<std::string> readHead(const std::string& sPath, size_t nLines) {
+        std::vector<std::string> vLines;
+        std::ifstream fsIn(sPath);
+        std::string sLine;
+        while (vLines.size() < nLines && std::getline(fsIn, sLine)) vLines.push_back(sLine);
+        return vLines;
+    }
+
+    static bool isStale(const std::string& sPath, int64_t nStaleSeconds) {
+        std::error_code ec;
+        auto stTime = std::filesystem::last_write_time(sPath, ec);
+        if (ec) return true;
+        return (std::filesystem::file_time_type::clock::now() - stTime > std::chrono::seconds(nStaleSeconds));
+    }
+
+private:
+    std::string m_sPath;
+    std::ofstream m_fsOut;
+    std::mutex m_mutex;
+};
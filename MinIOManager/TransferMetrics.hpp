@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// counters of transferred objects per bucket since start, and of the batch in progress
+// (one *InThread call), time is split into listing, metadata calls and data transfer
+
+enum class TransferPhase {
+    List,
+    Meta,
+    Transfer,
+};
+
+struct TransferSummary {
+    uint64_t nObjects = 0;          // finished, failed included
+    uint64_t nFailed = 0;
+    uint64_t nBytes = 0;
+    uint64_t nRetries = 0;
+    int64_t nInFlight = 0;
+    double fListSeconds = 0;
+    double fMetaSeconds = 0;        // summed over worker threads
+    double fTransferSeconds = 0;    // summed over worker threads
+    double fWallSeconds = 0;        // batch only
+    // per object latency
+    double fP50Ms = 0;
+    double fP95Ms = 0;
+    double fP99Ms = 0;
+    double fMaxMs = 0;
+
+    double bytesPerSec() const { return fWallSeconds > 0 ? nBytes / fWallSeconds : 0; }
+};
+
+class TransferMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // latency histogram bounds in ms for the per bucket percentiles, the last bin is open
+    static constexpr std::array<double, 15> kBoundsMs = {
+        1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000, 60000,
+    };
+
+    TransferMetrics() = default;
+    TransferMetrics(const TransferMetrics&) = delete;
+    TransferMetrics& operator = (const TransferMetrics&) = delete;
+
+    void beginBatch() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stBatch = Stats();
+        m_vBatchLatency.clear();
+        m_tpBatchStart = Clock::now();
+    }
+
+    TransferSummary endBatch() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        TransferSummary stSummary = summarize(m_stBatch);
+        stSummary.fWallSeconds = std::chrono::duration<double>(Clock::now() - m_tpBatchStart).count();
+        std::vector<double>& vLatency = m_vBatchLatency;
+        if (!vLatency.empty()) {
+            std::sort(vLatency.begin(), vLatency.end());
+            auto funAt = [&vLatency](double dRatio) {
+                return vLatency[std::min(vLatency.size() - 1, static_cast<size_t>(dRatio * (vLatency.size() - 1) + 0.5))];
+            };
+            stSummary.fP50Ms = funAt(0.5);
+            stSummary.fP95Ms = funAt(0.95);
+            stSummary.fP99Ms = funAt(0.99);
+            stSummary.fMaxMs = vLatency.back();
+        }
+        return stSummary;
+    }
+
+    void beginObject(const std::string& sBucket) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_mapBuckets[sBucket].nInFlight;
+        ++m_stBatch.nInFlight;
+    }
+
+    void endObject(const std::string& sBucket, uint64_t nBytes, Clock::duration stLatency, bool bSuccess) {
+        double fMs = std::chrono::duration<double, std::milli>(stLatency).count();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Stats* pStats : {&m_mapBuckets[sBucket], &m_stBatch}) {
+            --pStats->nInFlight;
+            ++pStats->nObjects;
+            if (!bSuccess) ++pStats->nFailed;
+            else pStats->nBytes += nBytes;
+            pStats->fMaxMs = std::max(pStats->fMaxMs, fMs);
+            ++pStats->vHistogram[std::lower_bound(kBoundsMs.begin(), kBoundsMs.end(), fMs) - kBoundsMs.begin()];
+        }
+        m_vBatchLatency.push_back(fMs);
+    }
+
+    void addRetry(const std::string& sBucket) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_mapBuckets[sBucket].nRetries;
+        ++m_stBatch.nRetries;
+    }
+
+    void addPhase(const std::string& sBucket, TransferPhase ePhase, Clock::duration stTime) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Stats* pStats : {&m_mapBuckets[sBucket], &m_stBatch}) {
+            pStats->vPhaseTime[static_cast<size_t>(ePhase)] += stTime;
+        }
+    }
+
+    std::map<std::string, TransferSummary> buckets() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::string, TransferSummary> mapRes;
+        for (const auto& item : m_mapBuckets) mapRes[item.first] = summarize(item.second);
+        return mapRes;
+    }
+
+    // prometheus text exposition, serve it from a /metrics handler
+    std::string prometheusText(const std::string& sPrefix = "minio_manager") const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string sOut;
+        auto funLine = [&](const std::string& sName, const std::string& sLabels, double fValue) {
+            char szValue[32];
+            std::snprintf(szValue, sizeof(szValue), "%.6g", fValue);
+            sOut += sPrefix + "_" + sName + "{" + sLabels + "} " + szValue + "\n";
+        };
+        static const char* vPhases[] = {"list", "meta", "transfer"};
+        for (const auto& item : m_mapBuckets) {
+            const Stats& stStats = item.second;
+            std::string sBucket = "bucket=\"" + item.first + "\"";
+            funLine("objects_total", sBucket, stStats.nObjects);
+            funLine("failed_total", sBucket, stStats.nFailed);
+            funLine("bytes_total", sBucket, stStats.nBytes);
+            funLine("retries_total", sBucket, stStats.nRetries);
+            funLine("in_flight", sBucket, stStats.nInFlight);
+            for (size_t i = 0; i < 3; ++i) {
+                funLine("phase_seconds_total", sBucket + ",phase=\"" + vPhases[i] + "\"",
+                    std::chrono::duration<double>(stStats.vPhaseTime[i]).count());
+            }
+            uint64_t nCumulative = 0;
+            for (size_t i = 0; i < kBoundsMs.size(); ++i) {
+                nCumulative += stStats.vHistogram[i];
+                char szLe[32];
+                std::snprintf(szLe, sizeof(szLe), "%g", kBoundsMs[i] / 1000);
+                funLine("object_seconds_bucket", sBucket + ",le=\"" + szLe + "\"", nCumulative);
+            }
+            funLine("object_seconds_bucket", sBucket + ",le=\"+Inf\"", stStats.nObjects);
+            funLine("object_seconds_count", sBucket, stStats.nObjects);
+        }
+        return sOut;
+    }
+
+private:
+    struct Stats {
+        uint64_t nObjects = 0;
+        uint64_t nFailed = 0;
+        uint64_t nBytes = 0;
+        uint64_t nRetries = 0;
+        int64_t nInFlight = 0;
+        double fMaxMs = 0;
+        std::array<Clock::duration, 3> vPhaseTime{};
+        std::array<uint64_t, kBoundsMs.size() + 1> vHistogram{};
+    };
+
+    // percentiles from the histogram, upper bound of the bin holding the rank
+    static TransferSummary summarize(const Stats& stStats) {
+        TransferSummary stSummary;
+        stSummary.nObjects = stStats.nObjects;
+        stSummary.nFailed = stStats.nFailed;
+        stSummary.nBytes = stStats.nBytes;
+        stSummary.nRetries = stStats.nRetries;
+        stSummary.nInFlight = stStats.nInFlight;
+        stSummary.fListSeconds = std::chrono::duration<double>(stStats.vPhaseTime[0]).count();
+        stSummary.fMetaSeconds = std::chrono::duration<double>(stStats.vPhaseTime[1]).count();
+        stSummary.fTransferSeconds = std::chrono::duration<double>(stStats.vPhaseTime[2]).count();
+        stSummary.fMaxMs = stStats.fMaxMs;
+        auto funAt = [&stStats](double dRatio) {
+            uint64_t nRank = static_cast<uint64_t>(dRatio * stStats.nObjects + 0.5);
+            uint64_t nCumulative = 0;
+            for (size_t i = 0; i < kBoundsMs.size(); ++i) {
+                nCumulative += stStats.vHistogram[i];
+                if (nCumulative >= nRank) return std::min(kBoundsMs[i], stStats.fMaxMs);
+            }
+            return stStats.fMaxMs;
+        };
+        if (stStats.nObjects > 0) {
+            stSummary.fP50Ms = funAt(0.5);
+            stSummary.fP95Ms = funAt(0.95);
+            stSummary.fP99Ms = funAt(0.99);
+        }
+        return stSummary;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::string, Stats> m_mapBuckets;
+    Stats m_stBatch;
+    std::vector<double> m_vBatchLatency;
+    Clock::time_point m_tpBatchStart = Clock::now();
+};
+
+// times a phase of sBucket until it goes out of scope
+class PhaseTimer {
+public:
+    PhaseTimer(TransferMetrics& stMetrics, const std::string& sBucket, TransferPhase ePhase)
+        : m_stMetrics(stMetrics), m_sBucket(sBucket), m_ePhase(ePhase), m_tpStart(TransferMetrics::Clock::now()) {}
+    ~PhaseTimer() {
+        m_stMetrics.addPhase(m_sBucket, m_ePhase, TransferMetrics::Clock::now() - m_tpStart);
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator = (const PhaseTimer&) = delete;
+
+private:
+    TransferMetrics& m_stMetrics;
+    const std::string& m_sBucket;
+    TransferPhase m_ePhase;
+    TransferMetrics::Clock::time_point m_tpStart;
+};
+
+// one *InThread call, the summary lands in pSummary however the call returns
+class BatchScope {
+public:
+    BatchScope(TransferMetrics& stMetrics, TransferSummary* pSummary) : m_stMetrics(stMetrics), m_pSummary(pSummary) {
+        m_stMetrics.beginBatch();
+    }
+    ~BatchScope() {
+        TransferSummary stSummary = m_stMetrics.endBatch();
+        if (m_pSummary) *m_pSummary = stSummary;
+    }
+
+    BatchScope(const BatchScope&) = delete;
+    BatchScope& operator = (const BatchScope&) = delete;
+
+private:
+    TransferMetrics& m_stMetrics;
+    TransferSummary* m_pSummary;
+};
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include "MinIOManager.h"
+#include "S3StandIn.hpp"
+
+// directory upload/download throughput and per object latency against S3StandIn
+// then directory download throughput for 1 to 32 transfer workers, each with its own client
+// usage: s3bench [files=200] [size_kb=256] [threads=8] [latency_ms=0] [bandwidth_mbps=0] [error_rate=0]
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point tpStart) {
+    return std::chrono::duration<double>(Clock::now() - tpStart).count();
+}
+
+static double percentile(std::vector<double> vValues, double dRatio) {
+    if (vValues.empty()) return 0;
+    std::sort(vValues.begin(), vValues.end());
+    size_t nIndex = std::min(vValues.size() - 1, static_cast<size_t>(dRatio * (vValues.size() - 1) + 0.5));
+    return vValues[nIndex];
+}
+
+// run funOne(i) for i in [0, nCount) on nThreads threads, latency of each call in ms
+static std::vector<double> timeEach(size_t nCount, size_t nThreads, const std::function<bool(size_t)>& funOne, size_t& nFailed) {
+    std::vector<double> vLatency(nCount, 0);
+    std::atomic<size_t> nNext = 0;
+    std::atomic<size_t> nFails = 0;
+    std::vector<std::thread> vThreads;
+    for (size_t t = 0; t < nThreads; ++t) {
+        vThreads.emplace_back([&] {
+            for (size_t i = nNext++; i < nCount; i = nNext++) {
+                auto tpStart = Clock::now();
+                if (!funOne(i)) ++nFails;
+                vLatency[i] = secondsSince(tpStart) * 1000;
+            }
+        });
+    }
+    for (auto& th : vThreads) th.join();
+    nFailed = nFails;
+    return vLatency;
+}
+
+static void report(const char* szName, size_t nBytes, double dSeconds, const std::vector<double>& vLatency, size_t nFailed) {
+    std::printf("%-18s %10.1f MB/s", szName, nBytes / dSeconds / (1 << 20));
+    if (!vLatency.empty()) {
+        std::printf("   p50 %7.2f ms  p95 %7.2f ms  p99 %7.2f ms  max %7.2f ms", percentile(vLatency, 0.5), 
+            percentile(vLatency, 0.95), percentile(vLatency, 0.99), percentile(vLatency, 1.0));
+    }
+    std::printf("   failed %zu\n", nFailed);
+}
+
+static void reportBatch(const char* szName, const TransferSummary& stSummary) {
+    std::printf("%-18s %10.1f MB/s   p50 %7.2f ms  p95 %7.2f ms  p99 %7.2f ms  max %7.2f ms   failed %llu\n", szName, 
+        stSummary.bytesPerSec() / (1 << 20), stSummary.fP50Ms, stSummary.fP95Ms, stSummary.fP99Ms, stSummary.fMaxMs, 
+        static_cast<unsigned long long>(stSummary.nFailed));
+    std::printf("%-18s list %.3f s, meta %.3f s, transfer %.3f s (thread time), %llu retries\n", "", stSummary.fListSeconds, 
+        stSummary.fMetaSeconds, stSummary.fTransferSeconds, static_cast<unsigned long long>(stSummary.nRetries));
+}
+
+int main(int argc, char** argv) {
+    size_t nFiles = (argc > 1 ? std::stoul(argv[1]) : 200);
+    size_t nFileSize = (argc > 2 ? std::stoul(argv[2]) : 256) << 10;
+    size_t nThreads = (argc > 3 ? std::stoul(argv[3]) : 8);
+    StandInOptions stOptions;
+    stOptions.nLatencyMs = (argc > 4 ? std::stoi(argv[4]) : 0);
+    stOptions.nBandwidth = (argc > 5 ? std::stoul(argv[5]) : 0) * 1000000 / 8;
+    stOptions.dErrorRate = (argc > 6 ? std::stod(argv[6]) : 0.0);
+    stOptions.nThreads = std::max<size_t>(nThreads * 2, 64);
+
+    auto pLogger = spdlog::stdout_color_mt("MinIOManager");
+    pLogger->set_level(spdlog::level::err);
+
+    S3StandIn stServer(stOptions);
+    if (stServer.start() < 0) {
+        std::fprintf(stderr, "stand-in failed to listen\n");
+        return EXIT_FAILURE;
+    }
+
+    auto fsRoot = std::filesystem::temp_directory_path() / ("s3bench_" + std::to_string(getpid()));
+    std::string sSrc = (fsRoot / "src").string();
+    std::string sDst = (fsRoot / "dst").string();
+    std::vector<std::string> vNames;
+    std::mt19937_64 stRandom(7);
+    std::string sData(nFileSize, '\0');
+    for (size_t i = 0; i < nFiles; ++i) {
+        // a few levels like a tile tree
+        std::string sName = "L" + std::to_string(i % 4) + "/" + std::to_string(i % 16) + "/" + std::to_string(i) + ".bin";
+        std::filesystem::create_directories(std::filesystem::path(sSrc + "/" + sName).parent_path());
+        for (auto& c : sData) c = static_cast<char>(stRandom());
+        std::ofstream(sSrc + "/" + sName, std::ios::binary).write(sData.data(), sData.size());
+        vNames.push_back(sName);
+    }
+    size_t nTotal = nFiles * nFileSize;
+    std::printf("%zu files x %zu KB, %zu threads, latency %d ms, bandwidth %zu B/s, error rate %.3f\n", 
+        nFiles, nFileSize >> 10, nThreads, stOptions.nLatencyMs, stOptions.nBandwidth, stOptions.dErrorRate);
+
+    MinIOManager stManager(stServer.endpoint(), false, "bench", "benchsecret");
+    stManager.setScanThreads(nThreads);
+
+    TransferSummary stSummary;
+    stManager.uploadDirectoryInThread("bench", "dir", sSrc, true, &stSummary);
+    reportBatch("dir upload", stSummary);
+
+    stManager.downloadFilteredInThread("bench", "dir", sDst, ObjectFilter(), &stSummary);
+    reportBatch("dir download", stSummary);
+
+    auto tpStart = Clock::now();
+    size_t nFailed = 0;
+    auto vLatency = timeEach(nFiles, nThreads, [&](size_t i) {
+        return stManager.uploadObject("bench", "single/" + vNames[i], sSrc + "/" + vNames[i]);
+    }, nFailed);
+    report("object upload", nTotal, secondsSince(tpStart), vLatency, nFailed);
+
+    tpStart = Clock::now();
+    vLatency = timeEach(nFiles, nThreads, [&](size_t i) {
+        return stManager.downloadObject("bench", "single/" + vNames[i], sDst + "/single/" + vNames[i]);
+    }, nFailed);
+    report("object download", nTotal, secondsSince(tpStart), vLatency, nFailed);
+
+    std::printf("\n%-18s %10s %10s %10s\n", "workers", "MB/s", "p50 ms", "p99 ms");
+    for (size_t nWorkers : {1, 2, 4, 8, 16, 32}) {
+        stManager.setTransferThreads(nWorkers);
+        std::string sScaleDst = sDst + "/scale_" + std::to_string(nWorkers);
+        stManager.downloadFilteredInThread("bench", "dir", sScaleDst, ObjectFilter(), &stSummary);
+        std::printf("%-18zu %10.1f %10.2f %10.2f\n", nWorkers, stSummary.bytesPerSec() / (1 << 20), 
+            stSummary.fP50Ms, stSummary.fP99Ms);
+    }
+
+    StandInStats stStats = stServer.stats();
+    std::printf("%s", stManager.metricsText().c_str());
+    std::printf("server: %zu requests, %zu injected errors, %zu bytes in, %zu bytes out\n", 
+        stStats.nRequests, stStats.nInjectedErrors, stStats.nBytesIn, stStats.nBytesOut);
+
+    stServer.stop();
+    std::error_code ec;
+    std::filesystem::remove_all(fsRoot, ec);
+    return EXIT_SUCCESS;
+}
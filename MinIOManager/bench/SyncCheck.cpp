@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#include "MinIOManager.h"
+#include "S3StandIn.hpp"
+
+// directory sync behaviour against S3StandIn, exit code is the number of failed checks
+
+static int g_nFailed = 0;
+
+static void check(bool bOk, const char* szWhat) {
+    std::printf("%-60s %s\n", szWhat, bOk ? "ok" : "FAILED");
+    if (!bOk) ++g_nFailed;
+}
+
+int main() {
+    auto pLogger = spdlog::stdout_color_mt("MinIOManager");
+    pLogger->set_level(spdlog::level::err);
+
+    S3StandIn stServer;
+    if (stServer.start() < 0) {
+        std::fprintf(stderr, "stand-in failed to listen\n");
+        return EXIT_FAILURE;
+    }
+
+    auto fsRoot = std::filesystem::temp_directory_path() / ("synccheck_" + std::to_string(getpid()));
+    std::string sSrc = (fsRoot / "src").string();
+    std::filesystem::create_directories(sSrc + "/sub");
+    std::ofstream(sSrc + "/top.bin") << "top";
+    std::ofstream(sSrc + "/sub/nested.bin") << "nested";
+
+    MinIOManager stManager(stServer.endpoint(), false, "check", "checksecret");
+    SyncOptions stSync;
+    stSync.bDeleteOrphans = true;
+    stManager.setSyncOptions(stSync);
+
+    // flat upload with orphan deletion leaves the nested remote keys alone
+    stServer.makeBucket("sync");
+    stServer.putObject("sync", "dir/orphan.bin", "old");
+    stServer.putObject("sync", "dir/sub/nested.bin", "remote");
+    stServer.putObject("sync", "dir/sub/deeper/leaf.bin", "remote");
+    check(stManager.uploadDirectoryInThread("sync", "dir", sSrc, false) == EXIT_SUCCESS, "flat upload");
+    check(stServer.hasObject("sync", "dir/top.bin"), "flat upload: top level file uploaded");
+    check(!stServer.hasObject("sync", "dir/orphan.bin"), "flat upload: top level orphan removed");
+    check(stServer.hasObject("sync", "dir/sub/nested.bin"), "flat upload: nested key kept");
+    check(stServer.hasObject("sync", "dir/sub/deeper/leaf.bin"), "flat upload: deeper nested key kept");
+
+    // recursive upload owns the whole tree
+    check(stManager.uploadDirectoryInThread("sync", "dir", sSrc, true) == EXIT_SUCCESS, "recursive upload");
+    check(stServer.hasObject("sync", "dir/sub/nested.bin"), "recursive upload: nested file uploaded");
+    check(!stServer.hasObject("sync", "dir/sub/deeper/leaf.bin"), "recursive upload: nested orphan removed");
+
+    stServer.stop();
+    std::error_code ec;
+    std::filesystem::remove_all(fsRoot, ec);
+    return g_nFailed;
+}
@@ -42,6 +42,10 @@ bool B3DMWriter::writeB3DM(const std::string &sGLBFileName, const std::vector<do
 
     auto npos = sGLBFileName.find_last_of('.');
     std::string sB3DMFileName = sGLBFileName.substr(0, npos) + ".b3dm";
+    return writeB3DM(glbData, sB3DMFileName, vPosition);
+}
+
+bool B3DMWriter::writeB3DM(const std::vector<uint8_t> &glbData, const std::string &sB3DMFileName, const std::vector<double> &vPosition) {
     if (!writeB3DMFile(sB3DMFileName, glbData)) {
         std::cerr << "B3DM write failed" << std::endl;
         return false;
@@ -21,6 +21,8 @@ struct B3DMHeader {
 class B3DMWriter {
 public:
     bool writeB3DM(const std::string &sGLBFileName, const std::vector<double> &vPosition = {0, 0, 0});
+    // glb already in memory, ex: downloaded by MinIOManager::downloadToBuffer
+    bool writeB3DM(const std::vector<uint8_t> &vGLBData, const std::string &sB3DMFileName, const std::vector<double> &vPosition = {0, 0, 0});
     bool parseB3DM2GLB(const std::string& sB3DMFileName, const std::string &sGLBFileName);
  
     bool writeGLB2B3DM(const std::string &sGLBFileName, size_t nMeshCount = 1, const std::string& sOutName = "haige.b3dm");
@@ -277,9 +277,6 @@ bool VertexData::readPlyFile(const char*pFileIn) {
     char**  elemNames;
     int     fileType;
     float   version;
-    bool    result = false;
-    int     nComments;
-    char**  comments;
 
     PlyFile* file = NULL;
 
@@ -303,6 +300,46 @@ bool VertexData::readPlyFile(const char*pFileIn) {
         return false;
     }
 
+    return readPly( file, nPlyElems, elemNames, std::filesystem::path(pFileIn).parent_path() );
+}
+
+bool VertexData::readPlyBuffer(const char* pData, size_t nSize, const char* pBaseDir) {
+    int     nPlyElems;
+    char**  elemNames;
+
+    // ply_read works on FILE*, read the buffer in place through a memory stream
+    FILE* fp = fmemopen( const_cast< char* >( pData ), nSize, "rb" );
+    if( !fp )
+    {
+        std::cerr << "Unable to open PLY buffer of " << nSize << " bytes." << std::endl;
+        return false;
+    }
+
+    PlyFile* file = NULL;
+    try{
+            file = ply_read( fp, &nPlyElems, &elemNames );
+    }
+    catch( std::exception& e )
+    {
+        std::cerr << "Unable to read PLY buffer, an exception occurred:  "
+                    << e.what() << std::endl;
+    }
+
+    if( !file )
+    {
+        std::cerr << "Unable to read PLY buffer of " << nSize << " bytes." << std::endl;
+        std::fclose( fp );
+        return false;
+    }
+
+    return readPly( file, nPlyElems, elemNames, std::filesystem::path(pBaseDir) );
+}
+
+bool VertexData::readPly( PlyFile* file, int nPlyElems, char** elemNames, const std::filesystem::path& fsBaseDir ) {
+    bool    result = false;
+    int     nComments;
+    char**  comments;
+
     MESHASSERT( elemNames != 0 );
 
 
@@ -327,7 +364,7 @@ bool VertexData::readPlyFile(const char*pFileIn) {
             std::string textureFile = comments[i]+12;
             if (!std::filesystem::path(textureFile).is_absolute())
             {
-                textureFile = std::filesystem::path(pFileIn).parent_path() / textureFile;
+                textureFile = fsBaseDir / textureFile;
             }
             vTextureFiles.push_back(textureFile);
         }
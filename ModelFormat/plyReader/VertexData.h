@@ -1,5 +1,6 @@
 #pragma once 
 
+#include <filesystem>
 #include <vector>
 #include <string>
 
@@ -14,6 +15,8 @@ public:
     VertexData();
 
     bool readPlyFile(const char*pFileIn);
+    // parse a ply already in memory, relative TextureFile comments resolve against pBaseDir
+    bool readPlyBuffer(const char* pData, size_t nSize, const char* pBaseDir = "");
 
     void useInvertedFaces() { _invertFaces = true; }
 
@@ -50,6 +53,9 @@ private:
     // Reads the triangle indices from the ply file
     void readTriangles( PlyFile* file, const int nFaces );
 
+    // Reads all elements of an opened ply and releases it
+    bool readPly( PlyFile* file, int nPlyElems, char** elemNames, const std::filesystem::path& fsBaseDir );
+
     bool        _invertFaces;
 
     
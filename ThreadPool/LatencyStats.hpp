@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// lock-free log-bucketed latency histogram (4 sub buckets per power of two, ~25% resolution)
+// and a registry of histograms per (operation, endpoint)
+
+namespace Haige {
+
+class LatencyHistogram {
+public:
+    static constexpr size_t kNumBuckets = 4 * 40;
+
+    void record(uint64_t nMicros, bool bError = false) {
+        m_vBuckets[bucketOf(nMicros)].fetch_add(1, std::memory_order_relaxed);
+        m_nCount.fetch_add(1, std::memory_order_relaxed);
+        m_nSumMicros.fetch_add(nMicros, std::memory_order_relaxed);
+        if (bError) m_nErrors.fetch_add(1, std::memory_order_relaxed);
+        uint64_t nMax = m_nMaxMicros.load(std::memory_order_relaxed);
+        while (nMicros > nMax && !m_nMaxMicros.compare_exchange_weak(nMax, nMicros, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return m_nCount.load(std::memory_order_relaxed); }
+    uint64_t errors() const { return m_nErrors.load(std::memory_order_relaxed); }
+    uint64_t maxMicros() const { return m_nMaxMicros.load(std::memory_order_relaxed); }
+    double meanMicros() const {
+        uint64_t nCount = count();
+        return (nCount == 0 ? 0.0 : static_cast<double>(m_nSumMicros.load(std::memory_order_relaxed)) / nCount);
+    }
+
+    // upper bound of the bucket holding the fQuantile (0..1) sample
+    uint64_t percentileMicros(double fQuantile) const {
+        uint64_t nCount = count();
+        if (nCount == 0) return 0;
+        uint64_t nRank = static_cast<uint64_t>(fQuantile * (nCount - 1)) + 1;
+        uint64_t nSeen = 0;
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            nSeen += m_vBuckets[i].load(std::memory_order_relaxed);
+            if (nSeen >= nRank) return std::min(bucketUpper(i), maxMicros());
+        }
+        return maxMicros();
+    }
+
+    void reset() {
+        for (auto& nBucket : m_vBuckets) nBucket.store(0, std::memory_order_relaxed);
+        m_nCount.store(0, std::memory_order_relaxed);
+        m_nErrors.store(0, std::memory_order_relaxed);
+        m_nSumMicros.store(0, std::memory_order_relaxed);
+        m_nMaxMicros.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static size_t bucketOf(uint64_t nMicros) {
+        if (nMicros < 4) return nMicros;
+        size_t nExp = 63 - __builtin_clzll(nMicros);
+        size_t nSub = (nMicros >> (nExp - 2)) & 3;
+        return std::min(4 * (nExp - 1) + nSub, kNumBuckets - 1);
+    }
+
+    static uint64_t bucketUpper(size_t nIdx) {
+        if (nIdx < 4) return nIdx;
+        size_t nExp = nIdx / 4 + 1;
+        size_t nSub = nIdx % 4;
+        return ((4 + nSub + 1) << (nExp - 2)) - 1;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kNumBuckets> m_vBuckets{};
+    std::atomic<uint64_t> m_nCount = 0;
+    std::atomic<uint64_t> m_nErrors = 0;
+    std::atomic<uint64_t> m_nSumMicros = 0;
+    std::atomic<uint64_t> m_nMaxMicros = 0;
+};
+
+struct OpStats {
+    std::string sOp;
+    std::string sEndpoint;
+    uint64_t nCount = 0;
+    uint64_t nErrors = 0;
+    double fMeanMicros = 0;
+    uint64_t nP50Micros = 0;
+    uint64_t nP99Micros = 0;
+    uint64_t nMaxMicros = 0;
+};
+
+class LatencyRegistry {
+public:
+    LatencyHistogram& histogram(const std::string& sOp, const std::string& sEndpoint) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& pHist = m_mapHists[{sOp, sEndpoint}];
+        if (pHist == nullptr) pHist = std::make_unique<LatencyHistogram>();
+        return *pHist;
+    }
+
+    std::vector<OpStats> snapshot() const {
+        std::vector<OpStats> vStats;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& item : m_mapHists) {
+            const LatencyHistogram& stHist = *item.second;
+            OpStats stStats;
+            stStats.sOp = item.first.first;
+            stStats.sEndpoint = item.first.second;
+            stStats.nCount = stHist.count();
+            stStats.nErrors = stHist.errors();
+            stStats.fMeanMicros = stHist.meanMicros();
+            stStats.nP50Micros = stHist.percentileMicros(0.5);
+            stStats.nP99Micros = stHist.percentileMicros(0.99);
+            stStats.nMaxMicros = stHist.maxMicros();
+            vStats.push_back(stStats);
+        }
+        return vStats;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& item : m_mapHists) item.second->reset();
+    }
+
+private:
+    // (operation, endpoint) -> histogram, entries are never removed so references stay valid
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<LatencyHistogram> > m_mapHists;
+    mutable std::mutex m_mutex;
+};
+
+// record the lifetime of the scope into a histogram, call fail() on error paths
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& stHist)
+        : m_stHist(stHist), m_stStart(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() {
+        auto nMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - m_stStart).count();
+        m_stHist.record(static_cast<uint64_t>(nMicros), m_bError);
+    }
+
+    void fail() { m_bError = true; }
+
+private:
+    LatencyHistogram& m_stHist;
+    std::chrono::steady_clock::time_point m_stStart;
+    bool m_bError = false;
+};
+
+} // end of namespace Haige
@@ -0,0 +1,53 @@
+#include "ProgressSubscriber.h"
+
+namespace Haige {
+
+ProgressSubscriber::ProgressSubscriber(const sw::redis::ConnectionOptions& stOptions, ProgressCallback funCallback, 
+                                    const std::string& sChannelPrefix) 
+    : m_stOptions(stOptions), m_funCallback(std::move(funCallback)), m_sChannelPrefix(sChannelPrefix) {
+    // wake up every second to check the stop flag
+    m_stOptions.socket_timeout = std::chrono::seconds(1);
+}
+
+ProgressSubscriber::~ProgressSubscriber() {
+    stop();
+}
+
+void ProgressSubscriber::start() {
+    if (m_bRunning) return;
+    m_bStop = false;
+    m_bRunning = true;
+    m_stThread = std::thread(&ProgressSubscriber::workerFunc, this);
+}
+
+void ProgressSubscriber::stop() {
+    m_bStop = true;
+    if (m_stThread.joinable()) m_stThread.join();
+    m_bRunning = false;
+}
+
+void ProgressSubscriber::workerFunc() {
+    while (!m_bStop) {
+        try {
+            sw::redis::Redis redis(m_stOptions);
+            auto stSubscriber = redis.subscriber();
+            stSubscriber.on_pmessage([this](std::string sPattern, std::string sChannel, std::string sValue) {
+                if (sChannel.compare(0, m_sChannelPrefix.size(), m_sChannelPrefix) != 0) return;
+                m_funCallback(std::string_view(sChannel).substr(m_sChannelPrefix.size()), sValue);
+            });
+            stSubscriber.psubscribe(m_sChannelPrefix + "*");
+            while (!m_bStop) {
+                try {
+                    stSubscriber.consume();
+                } catch (const sw::redis::TimeoutError& e) {
+                    continue;
+                }
+            }
+        } catch (const sw::redis::Error& e) {
+            printf("ProgressSubscriber %s\n", e.what());
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+}
+
+} // end of namespace Haige
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sw/redis++/redis++.h>
+
+namespace Haige {
+
+// receive progress pushed by RedisManager in PROGRESS_PUBLISH mode, ex: httpserver forwards to clients
+// streams written in PROGRESS_STREAM mode can be replayed with XRANGE GEN_MODELING_STREAM:<taskId>
+class ProgressSubscriber {
+public:
+    // (taskId, progress json {"progress":..,"message":..})
+    using ProgressCallback = std::function<void(std::string_view, const std::string&)>;
+
+    ProgressSubscriber(const sw::redis::ConnectionOptions& stOptions, ProgressCallback funCallback, 
+                    const std::string& sChannelPrefix = "GEN_MODELING:");
+    ~ProgressSubscriber();
+
+    ProgressSubscriber(const ProgressSubscriber&) = delete;
+    ProgressSubscriber& operator=(const ProgressSubscriber&) = delete;
+
+    // listen to all tasks on the channel prefix in a background thread
+    void start();
+    void stop();
+    bool isRunning() const { return m_bRunning; }
+
+private:
+    void workerFunc();
+
+private:
+    sw::redis::ConnectionOptions m_stOptions;
+    ProgressCallback m_funCallback;
+    std::string m_sChannelPrefix;
+    std::thread m_stThread;
+    std::atomic<bool> m_bRunning = false;
+    std::atomic<bool> m_bStop = false;
+};
+
+} // end of namespace Haige
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "TaskIdIndex.hpp"
+
+// in-process lru cache of string values with per entry ttl, for read-mostly keys
+
+namespace Haige {
+
+struct ReadCacheStats {
+    uint64_t nHits = 0;
+    uint64_t nMisses = 0;
+    uint64_t nExpired = 0;      // misses caused by an expired entry
+    uint64_t nEvictions = 0;    // entries dropped by the size bound
+    uint64_t nInvalidations = 0;
+    size_t nEntries = 0;
+
+    double hitRatio() const {
+        uint64_t nTotal = nHits + nMisses;
+        return (nTotal == 0 ? 0.0 : static_cast<double>(nHits) / nTotal);
+    }
+};
+
+class ReadCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ReadCache(size_t nMaxEntries = 1024, std::chrono::milliseconds stDefaultTtl = std::chrono::seconds(5))
+        : m_nMaxEntries(nMaxEntries), m_stDefaultTtl(stDefaultTtl) {}
+
+    ReadCache(const ReadCache&) = delete;
+    ReadCache& operator = (const ReadCache&) = delete;
+
+    void configure(size_t nMaxEntries, std::chrono::milliseconds stDefaultTtl) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_nMaxEntries = nMaxEntries;
+        m_stDefaultTtl = stDefaultTtl;
+        while (m_mapEntries.size() > m_nMaxEntries) evictOldest();
+    }
+
+    std::chrono::milliseconds defaultTtl() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stDefaultTtl;
+    }
+
+    bool get(std::string_view sKey, std::string& sValue) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapEntries.find(sKey);
+        if (itr == m_mapEntries.end()) {
+            ++m_stStats.nMisses;
+            return false;
+        }
+        if (Clock::now() >= itr->second.stExpire) {
+            m_lsLru.erase(itr->second.itrLru);
+            m_mapEntries.erase(itr);
+            ++m_stStats.nExpired;
+            ++m_stStats.nMisses;
+            return false;
+        }
+        m_lsLru.splice(m_lsLru.begin(), m_lsLru, itr->second.itrLru);
+        sValue = itr->second.sValue;
+        ++m_stStats.nHits;
+        return true;
+    }
+
+    // stTtl <= 0 means use the default ttl
+    void put(const std::string& sKey, const std::string& sValue, std::chrono::milliseconds stTtl = std::chrono::milliseconds(0)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        putLocked(sKey, sValue, stTtl);
+    }
+
+    // taken before a read-through fetch, ex: a redis GET racing a SET from another thread
+    uint64_t generation(std::string_view sKey) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_vGenerations[slotOf(sKey)];
+    }
+
+    // put unless sKey was invalidated since generation() returned nGeneration, the fetched value may be stale then
+    bool putIfGeneration(const std::string& sKey, const std::string& sValue, uint64_t nGeneration,
+                        std::chrono::milliseconds stTtl = std::chrono::milliseconds(0)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_vGenerations[slotOf(sKey)] != nGeneration) return false;
+        putLocked(sKey, sValue, stTtl);
+        return true;
+    }
+
+    void invalidate(std::string_view sKey) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // also without an entry, a fetch in flight must not cache the old value
+        ++m_vGenerations[slotOf(sKey)];
+        auto itr = m_mapEntries.find(sKey);
+        if (itr == m_mapEntries.end()) return;
+        m_lsLru.erase(itr->second.itrLru);
+        m_mapEntries.erase(itr);
+        ++m_stStats.nInvalidations;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& nGeneration : m_vGenerations) ++nGeneration;
+        m_mapEntries.clear();
+        m_lsLru.clear();
+    }
+
+    ReadCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ReadCacheStats stStats = m_stStats;
+        stStats.nEntries = m_mapEntries.size();
+        return stStats;
+    }
+
+    void resetStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stStats = ReadCacheStats();
+    }
+
+private:
+    static size_t slotOf(std::string_view sKey) {
+        return TaskIdHash{}(sKey) % kGenerationSlots;
+    }
+
+    void putLocked(const std::string& sKey, const std::string& sValue, std::chrono::milliseconds stTtl) {
+        if (m_nMaxEntries == 0) return;
+        auto stExpire = Clock::now() + (stTtl.count() > 0 ? stTtl : m_stDefaultTtl);
+
+        auto itr = m_mapEntries.find(sKey);
+        if (itr != m_mapEntries.end()) {
+            itr->second.sValue = sValue;
+            itr->second.stExpire = stExpire;
+            m_lsLru.splice(m_lsLru.begin(), m_lsLru, itr->second.itrLru);
+            return;
+        }
+        while (m_mapEntries.size() >= m_nMaxEntries) evictOldest();
+
+        auto [itrNew, bInserted] = m_mapEntries.try_emplace(sKey);
+        m_lsLru.push_front(itrNew->first);
+        itrNew->second.sValue = sValue;
+        itrNew->second.stExpire = stExpire;
+        itrNew->second.itrLru = m_lsLru.begin();
+    }
+
+    void evictOldest() {
+        if (m_lsLru.empty()) return;
+        m_mapEntries.erase(m_mapEntries.find(m_lsLru.back()));
+        m_lsLru.pop_back();
+        ++m_stStats.nEvictions;
+    }
+
+private:
+    struct Entry {
+        std::string sValue;
+        Clock::time_point stExpire;
+        std::list<std::string_view>::iterator itrLru;
+    };
+
+    size_t m_nMaxEntries;
+    std::chrono::milliseconds m_stDefaultTtl;
+    // front is the most recently used, views the keys of m_mapEntries
+    std::list<std::string_view> m_lsLru;
+    std::unordered_map<std::string, Entry, TaskIdHash, std::equal_to<> > m_mapEntries;
+    ReadCacheStats m_stStats;
+    // invalidation counters of hashed key slots, bounded unlike one per key; a shared slot only skips a put
+    static constexpr size_t kGenerationSlots = 256;
+    std::array<uint64_t, kGenerationSlots> m_vGenerations{};
+    mutable std::mutex m_mutex;
+};
+
+} // end of namespace Haige
@@ -1,5 +1,7 @@
 #include "RedisManager.h"
 
+#include <algorithm>
+
 // simdjson: fastest but only parse; REPIDJSON faster; nlohman::json normal but easy use
 #include "simdjson.h"
 #include "rapidjson/writer.h"
@@ -12,8 +14,20 @@ RedisManager::RedisManager() {
     m_stConnectionPoolOpt.connection_lifetime = std::chrono::hours(8);
 }
 
-bool RedisManager::registRedisAddr(const std::string& sTaskId, const std::string& sRedisAddr, const std::string& sRedisPs, 
-                                int nRedisDB, const std::vector<std::string>& vTaskIds) {
+RedisManager::~RedisManager() {
+    // keep the spill file for the next run
+    stopReplay();
+    m_bWriteBehind = false;
+    m_bStopInvalidation = true;
+    std::lock_guard<std::mutex> lock(m_mutexInvalidation);
+    for (auto& item : m_mapInvalidationThreads) {
+        if (item.second.joinable()) item.second.join();
+    }
+    m_mapInvalidationThreads.clear();
+}
+
+bool parseRedisAddr(const std::string& sRedisAddr, const std::string& sRedisPs, int nRedisDB, 
+                    sw::redis::ConnectionOptions& stOptions) {
     std::regex pattern(R"((https?)://([^/:]+)(?::(\d+))?)");
     std::smatch matches;
     if (!std::regex_match(sRedisAddr, matches, pattern)) {
@@ -21,48 +35,58 @@ bool RedisManager::registRedisAddr(const std::string& sTaskId, const std::string
         return false;
     }
 
+    stOptions.host = matches[2].str();
+    stOptions.port = matches[3].matched ? std::stoi(matches[3].str()) : 6379;
+    stOptions.password = sRedisPs;
+    stOptions.db = nRedisDB;
+    return true;
+}
+
+bool RedisManager::registRedisAddr(const std::string& sTaskId, const std::string& sRedisAddr, const std::string& sRedisPs, 
+                                int nRedisDB, const std::vector<std::string>& vTaskIds) {
+    RedisConnectInfo info;
+    if (!parseRedisAddr(sRedisAddr, sRedisPs, nRedisDB, info.stRedisOptions)) {
+        return false;
+    }
+
     if (sTaskId.empty()) {
         return false;
     } 
 
-    RedisConnectInfo info;
-    info.stRedisOptions.host = matches[2].str();
-    info.stRedisOptions.port = matches[3].matched ? std::stoi(matches[3].str()) : 6379;
-    info.stRedisOptions.password = sRedisPs;
-    info.stRedisOptions.db = nRedisDB;
-
-    m_mapRedisOptions.insert(std::make_pair(sTaskId, info));
     printf("addAddr : %s %d [%s(%u)] .\n", info.stRedisOptions.host.c_str(), info.stRedisOptions.port, sTaskId.c_str(), vTaskIds.size());
+    {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+        m_stTaskIndex.insertRoot(sTaskId, std::move(info));
+    }
     if (vTaskIds.size() > 0) {
-        m_mapSubTaskIds.insert({sTaskId, vTaskIds});
-        for (auto sId : vTaskIds) {
-            printf("subTaskId: %s\n", sId.c_str());
-        }
+        registSubTaskIds(sTaskId, vTaskIds);
+    }
+    return true;
+}
+
+bool RedisManager::registSubTaskIds(const std::string& sParentTaskId, const std::vector<std::string>& vTaskIds) {
+    std::lock_guard<std::mutex> lock(m_mutexIndex);
+    if (m_stTaskIndex.find(sParentTaskId) == nullptr) {
+        printf("regist sub task ids failed: task id [%s] not found!\n", sParentTaskId.c_str());
+        return false;
+    }
+    for (const auto& sId : vTaskIds) {
+        m_stTaskIndex.insertChild(sId, sParentTaskId);
+        printf("subTaskId: %s\n", sId.c_str());
     }
     return true;
 }
 
 void RedisManager::unregistRedisAddr(const std::string& sTaskId) {
-    auto itr = m_mapRedisOptions.find(sTaskId);
-    if (itr == m_mapRedisOptions.end()) return;
-    m_mapRedisOptions.erase(itr);
+    std::lock_guard<std::mutex> lock(m_mutexIndex);
+    if (m_stTaskIndex.find(sTaskId) == nullptr) return;
+    m_stTaskIndex.erase(sTaskId);
 
     auto stNow = std::chrono::steady_clock::now();
     auto stKeepTime = std::chrono::hours(24);
-    for (auto itr = m_mapRedisOptions.begin(); itr != m_mapRedisOptions.end();) {
-        auto diff = stNow - itr->second.stLastUsedTime;
-        if (diff > stKeepTime) {
-            itr = m_mapRedisOptions.erase(itr);
-        } else {
-            itr++;
-        }
-    }
-    {
-        auto itr = m_mapSubTaskIds.find(sTaskId);
-        if (itr != m_mapSubTaskIds.end()) {
-            m_mapSubTaskIds.erase(itr);
-        }
-    }
+    m_stTaskIndex.eraseRootsIf([&](const RedisConnectInfo& info) {
+        return (stNow - info.stLastUsedTime > stKeepTime);
+    });
 }
 
 bool RedisManager::updateProgress(const std::string& sTaskId, float fProgress, const std::string& sMessage) {
@@ -77,9 +101,21 @@ bool RedisManager::updateProgress(const std::string& sTaskId, float fProgress, c
 
     std::string sValue = stBuf.GetString();
     // printf("RedisManager::updateProgress %s %f\n", sTaskId.c_str(), fProgress);
-    bool bres = set("GEN_MODELING:", sValue, sTaskId);
+    int nMode = m_nPublishMode;
+    bool bres = true;
+    if (nMode & PROGRESS_SET) {
+        bres = set("GEN_MODELING:", sValue, sTaskId);
+    }
+    if (nMode & (PROGRESS_PUBLISH | PROGRESS_STREAM)) {
+        bres = publishProgress(sValue, sTaskId) && bres;
+    }
     if (fProgress < 0 || fProgress >= 100.0f) {
-        m_mapRedisOptions.erase(sTaskId);
+        // only a finished main task releases its ids, a finished sub task keeps routing
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+        auto pNode = m_stTaskIndex.find(sTaskId);
+        if (pNode != nullptr && pNode->isRoot()) {
+            m_stTaskIndex.erase(sTaskId);
+        }
     }
     return bres;
 }
@@ -92,26 +128,37 @@ bool RedisManager::updateProgressAssync(const std::string& sTaskId, float fProgr
     return true;
 }
 
+bool RedisManager::resolveTask(const std::string& sTaskId, const std::string& pKey, 
+                            sw::redis::ConnectionOptions& stOptions, std::vector<std::string>& vKeys) {
+    std::lock_guard<std::mutex> lock(m_mutexIndex);
+    auto pNode = m_stTaskIndex.find(sTaskId);
+    if (pNode == nullptr) {
+        return false;
+    }
+    RedisConnectInfo& info = pNode->info();
+    info.stLastUsedTime = std::chrono::steady_clock::now();
+    stOptions = info.stRedisOptions;
+    // set for all sub taskid under sTaskId, or sTaskId itself if it has no sub taskid
+    m_stTaskIndex.forEachLeaf(pNode, [&](std::string_view sLeafId) {
+        vKeys.emplace_back(pKey).append(sLeafId);
+    });
+    return true;
+}
+
 std::shared_ptr<sw::redis::Redis> RedisManager::getRedis(const std::string& sTaskId) {
-    bool bIsMainId = true;
-    std::string sMainTaskId = sTaskId;
-    auto itr = m_mapRedisOptions.find(sMainTaskId);
-    if (itr == m_mapRedisOptions.end()) {
-        bIsMainId = false;
-        sMainTaskId = sTaskId.substr(0, sTaskId.length() - 2);
-        itr = m_mapRedisOptions.find(sMainTaskId);
-        if (itr == m_mapRedisOptions.end()) {
-            printf("set redis value failed: task id [%s] not found!\n", sTaskId.c_str());
-            return nullptr;
-        }
+    std::lock_guard<std::mutex> lockIndex(m_mutexIndex);
+    auto pNode = m_stTaskIndex.find(sTaskId);
+    if (pNode == nullptr) {
+        printf("set redis value failed: task id [%s] not found!\n", sTaskId.c_str());
+        return nullptr;
     }
 
     {
         std::unique_lock<std::mutex> lock(m_mutex);
-        auto itrRedis = m_mapRedis.find(sMainTaskId);
+        auto itrRedis = m_mapRedis.find(pNode->pRoot->sId);
         if (itrRedis == m_mapRedis.end()) {
-            std::shared_ptr<sw::redis::Redis> pRedis = std::make_shared<sw::redis::Redis>(itr->second.stRedisOptions, m_stConnectionPoolOpt);
-            m_mapRedis.insert({sMainTaskId, pRedis});
+            std::shared_ptr<sw::redis::Redis> pRedis = std::make_shared<sw::redis::Redis>(pNode->info().stRedisOptions, m_stConnectionPoolOpt);
+            m_mapRedis.insert({std::string(pNode->pRoot->sId), pRedis});
             return pRedis;
         } else {
             return itrRedis->second;
@@ -120,108 +167,171 @@ std::shared_ptr<sw::redis::Redis> RedisManager::getRedis(const std::string& sTas
     return nullptr;
 }
 
-bool RedisManager::set(const std::string& pKey, const std::string& pValue, const std::string& sTaskId) {
+void RedisManager::setProgressPublishMode(int nMode, long long nStreamMaxLen) {
+    m_nPublishMode = nMode;
+    m_nStreamMaxLen = nStreamMaxLen;
+}
+
+bool RedisManager::publishProgress(const std::string& pValue, const std::string& sTaskId) {
     if (sTaskId.empty()) {
         return false;
     }
     if (!m_bValid) return true;
-    // printf("RedisManager::set %s %s %s\n", sTaskId.c_str(), pKey.c_str(), pValue.c_str());
+    sw::redis::ConnectionOptions stOptions;
+    std::vector<std::string> vTaskIds;
+    if (!resolveTask(sTaskId, "", stOptions, vTaskIds)) {
+        printf("publish progress failed: task id [%s] not found!\n", sTaskId.c_str());
+        return true;
+    }
+    int nMode = m_nPublishMode;
+    long long nStreamMaxLen = m_nStreamMaxLen;
+    std::initializer_list<std::pair<std::string_view, std::string_view> > vFields = {{"value", pValue}};
+    ScopedLatency stTimer(m_stLatency.histogram("publish", endpointOf(stOptions)));
     try {
-        std::unique_ptr<sw::redis::Redis> redis = nullptr;
-
-        auto itr = m_mapRedisOptions.find(sTaskId);
-        // set for all sub taskid or main taskid if has no sub taskid
-        if (itr != m_mapRedisOptions.end()) {
-            
-            redis = std::make_unique<sw::redis::Redis>(itr->second.stRedisOptions);
-            itr->second.stLastUsedTime = std::chrono::steady_clock::now();
-
-            auto nitr = m_mapSubTaskIds.find(sTaskId);
-            // only has one main taskid
-            if (nitr == m_mapSubTaskIds.end()) {
-                redis->set(pKey + sTaskId, pValue, std::chrono::hours(m_nKeepHour));
-            } else { // has several sub taskid
-                for (auto sSubTaskId : nitr->second) {
-                    redis->set(pKey + sSubTaskId, pValue, std::chrono::hours(m_nKeepHour));
-                }
+        sw::redis::Redis redis(stOptions);
+        // one round trip for all sub taskid
+        auto stPipe = redis.pipeline(false);
+        for (const auto& sId : vTaskIds) {
+            if (nMode & PROGRESS_PUBLISH) {
+                stPipe.publish("GEN_MODELING:" + sId, pValue);
             }
-            redis.reset();
-        } else {
-            // set for one sub taskid
-            std::string sMainTaskId = sTaskId.substr(0, sTaskId.length() - 2);
-            auto mitr = m_mapRedisOptions.find(sMainTaskId);
-            if (mitr == m_mapRedisOptions.end()) {
-                printf("set redis value [%s -> %s] failed: task id [%s](%s) not found!\n", pKey.c_str(), pValue.c_str(), sMainTaskId.c_str(), sTaskId.c_str());
-                return true;
+            if (nMode & PROGRESS_STREAM) {
+                stPipe.xadd("GEN_MODELING_STREAM:" + sId, "*", vFields.begin(), vFields.end(), nStreamMaxLen, true);
+                // streams of finished tasks expire like their keys
+                stPipe.expire("GEN_MODELING_STREAM:" + sId, std::chrono::hours(m_nKeepHour));
             }
-
-            redis = std::make_unique<sw::redis::Redis>(mitr->second.stRedisOptions);
-            mitr->second.stLastUsedTime = std::chrono::steady_clock::now();
-
-            redis->set(pKey + sTaskId, pValue, std::chrono::hours(m_nKeepHour));
-            
-            redis.reset();
         }
+        stPipe.exec();
     } catch (const sw::redis::Error& e) {
         printf("%s\n", e.what());
+        stTimer.fail();
         return false;
     }
     return true;
 }
 
+bool RedisManager::set(const std::string& pKey, const std::string& pValue, const std::string& sTaskId) {
+    if (sTaskId.empty()) {
+        return false;
+    }
+    if (!m_bValid) return true;
+    // printf("RedisManager::set %s %s %s\n", sTaskId.c_str(), pKey.c_str(), pValue.c_str());
+    sw::redis::ConnectionOptions stOptions;
+    std::vector<std::string> vKeys;
+    if (!resolveTask(sTaskId, pKey, stOptions, vKeys)) {
+        printf("set redis value [%s -> %s] failed: task id [%s] not found!\n", pKey.c_str(), pValue.c_str(), sTaskId.c_str());
+        return true;
+    }
+    bool bWriteBehind = m_bWriteBehind;
+    std::string sEndpoint = endpointOf(stOptions);
+    bool bBuffer = false;
+    if (bWriteBehind) {
+        stOptions.connect_timeout = m_stConnectTimeout.load();
+        stOptions.socket_timeout = m_stConnectTimeout.load();
+        bBuffer = shouldBuffer(sEndpoint, stOptions);
+    }
+    bool bRes = true;
+    if (!bBuffer) {
+        ScopedLatency stTimer(m_stLatency.histogram("set", sEndpoint));
+        try {
+            sw::redis::Redis redis(stOptions);
+            for (const auto& sKey : vKeys) {
+                redis.set(sKey, pValue, std::chrono::hours(m_nKeepHour));
+            }
+            if (bWriteBehind) recordResult(sEndpoint, stOptions, true);
+        } catch (const sw::redis::Error& e) {
+            printf("%s\n", e.what());
+            stTimer.fail();
+            bRes = false;
+            // below the threshold the caller sees the failure, buffered once the circuit opens
+            if (bWriteBehind) bBuffer = recordResult(sEndpoint, stOptions, false);
+        }
+    }
+    if (bBuffer) {
+        // keep the latest value, replayWorker sends it when the endpoint is back
+        for (const auto& sKey : vKeys) {
+            m_stWriteBehind.push(sEndpoint, sKey, pValue);
+        }
+        m_cvReplay.notify_one();
+        bRes = true;
+    }
+    if (m_bReadCache) {
+        for (const auto& sKey : vKeys) {
+            m_stReadCache.invalidate(cacheKey(stOptions, sKey));
+        }
+    }
+    return bRes;
+}
+
 bool RedisManager::set_v2(const std::string& pKey, const std::string& pValue, const std::string& sTaskId) {
     if (sTaskId.empty()) {
         return false;
     }
     if (!m_bValid) return true;
+    sw::redis::ConnectionOptions stOptions;
+    std::vector<std::string> vKeys;
+    if (!resolveTask(sTaskId, pKey, stOptions, vKeys)) return false;
+    ScopedLatency stTimer(m_stLatency.histogram("set_v2", endpointOf(stOptions)));
     try {
         std::shared_ptr<sw::redis::Redis> pRedis = getRedis(sTaskId);
         if (pRedis == nullptr) return false;
-        auto nitr = m_mapSubTaskIds.find(sTaskId);
-        // only has one main taskid
-        if (nitr == m_mapSubTaskIds.end()) {
-            pRedis->set(pKey + sTaskId, pValue, std::chrono::hours(m_nKeepHour));
-        } else { // has several sub taskid
-            for (auto sSubTaskId : nitr->second) {
-                pRedis->set(pKey + sSubTaskId, pValue, std::chrono::hours(m_nKeepHour));
-            }
+        for (const auto& sKey : vKeys) {
+            pRedis->set(sKey, pValue, std::chrono::hours(m_nKeepHour));
+            if (m_bReadCache) m_stReadCache.invalidate(cacheKey(stOptions, sKey));
         }
     } catch (const sw::redis::Error& e) {
         printf("%s\n", e.what());
+        stTimer.fail();
         return false;
     }
     return true;
 }
 
-std::string RedisManager::get(const std::string& pKey, const std::string& sTaskId) {
+std::string RedisManager::get(const std::string& pKey, const std::string& sTaskId, std::chrono::milliseconds stCacheTtl) {
     if (sTaskId.empty()) {
         return "";
     }
-    try {
-        std::unique_ptr<sw::redis::Redis> redis;
-            
-        auto itr = m_mapRedisOptions.find(sTaskId);
-        if (itr == m_mapRedisOptions.end()) {
+    sw::redis::ConnectionOptions stOptions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+        auto pNode = m_stTaskIndex.find(sTaskId);
+        if (pNode == nullptr) {
             printf("RedisManager::get sTaskId[%s] not found!\n", sTaskId.c_str());
             return "";
         }
-        else 
-            redis = std::make_unique<sw::redis::Redis>(itr->second.stRedisOptions);
+        stOptions = pNode->info().stRedisOptions;
+    }
+    bool bUseCache = (m_bReadCache && stCacheTtl.count() >= 0);
+    std::string sCacheKey;
+    uint64_t nGeneration = 0;
+    if (bUseCache) {
+        sCacheKey = cacheKey(stOptions, pKey);
+        std::string sValue;
+        if (m_stReadCache.get(sCacheKey, sValue)) {
+            return sValue;
+        }
+        nGeneration = m_stReadCache.generation(sCacheKey);
+    }
+    ScopedLatency stTimer(m_stLatency.histogram("get", endpointOf(stOptions)));
+    try {
+        sw::redis::Redis redis(stOptions);
         
-        auto pValue = redis->get(pKey);
+        auto pValue = redis.get(pKey);
         if (pValue) {
+            // a set/del since the GET was sent invalidated the key, the value may be older than redis
+            if (bUseCache) m_stReadCache.putIfGeneration(sCacheKey, *pValue, nGeneration, stCacheTtl);
             return std::string(*pValue);
         } else {
             printf("RedisManager::get failed, pKey = %s, sTaskId = %s, host = %s, port = %d, db = %d\n", 
                     pKey.c_str(), sTaskId.c_str(), 
-                    itr->second.stRedisOptions.host.c_str(),
-                    itr->second.stRedisOptions.port,
-                    itr->second.stRedisOptions.db);
+                    stOptions.host.c_str(),
+                    stOptions.port,
+                    stOptions.db);
         }
-        redis.reset();
 
     } catch (const sw::redis::Error& e) {
         printf("%s\n", e.what());
+        stTimer.fail();
     }
     printf("RedisManager::get empty\n");
     return "";
@@ -231,22 +341,26 @@ bool RedisManager::del(const std::string& pKey, const std::string& sTaskId) {
     if (sTaskId.empty()) {
         return false;
     }
+    sw::redis::ConnectionOptions stOptions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+        auto pNode = m_stTaskIndex.find(sTaskId);
+        if (pNode == nullptr) return false;
+        stOptions = pNode->info().stRedisOptions;
+    }
+    ScopedLatency stTimer(m_stLatency.histogram("del", endpointOf(stOptions)));
     try {
-        std::unique_ptr<sw::redis::Redis> redis;
+        sw::redis::Redis redis(stOptions);
         
-        auto itr = m_mapRedisOptions.find(sTaskId);
-        if (itr == m_mapRedisOptions.end())
-            return false;
-        else 
-            redis = std::make_unique<sw::redis::Redis>(itr->second.stRedisOptions);
-        
-        redis->ping();
-        redis->del(pKey);
-        redis.reset();
+        redis.ping();
+        redis.del(pKey);
     } catch (const sw::redis::Error& e) {
         printf("%s\n", e.what());
+        stTimer.fail();
+        if (m_bReadCache) m_stReadCache.invalidate(cacheKey(stOptions, pKey));
         return false;
     }
+    if (m_bReadCache) m_stReadCache.invalidate(cacheKey(stOptions, pKey));
     return true;
 }
 
@@ -254,4 +368,241 @@ void RedisManager::setValid(bool bValid) {
     m_bValid = bValid;
 }
 
+std::string RedisManager::endpointOf(const sw::redis::ConnectionOptions& stOptions) {
+    std::string sEndpoint = stOptions.host;
+    sEndpoint.append(":").append(std::to_string(stOptions.port))
+            .append("/").append(std::to_string(stOptions.db));
+    return sEndpoint;
+}
+
+std::string RedisManager::cacheKey(const sw::redis::ConnectionOptions& stOptions, std::string_view sKey) {
+    std::string sCacheKey = endpointOf(stOptions);
+    sCacheKey.append("|").append(sKey);
+    return sCacheKey;
+}
+
+void RedisManager::enableReadCache(size_t nMaxEntries, std::chrono::milliseconds stDefaultTtl) {
+    m_stReadCache.configure(nMaxEntries, stDefaultTtl);
+    m_bReadCache = true;
+}
+
+void RedisManager::disableReadCache() {
+    m_bReadCache = false;
+    m_stReadCache.clear();
+}
+
+ReadCacheStats RedisManager::getReadCacheStats() const {
+    return m_stReadCache.stats();
+}
+
+bool RedisManager::subscribeInvalidation(const std::string& sTaskId) {
+    sw::redis::ConnectionOptions stOptions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+        auto pNode = m_stTaskIndex.find(sTaskId);
+        if (pNode == nullptr) return false;
+        stOptions = pNode->info().stRedisOptions;
+    }
+    std::string sEndpoint = endpointOf(stOptions);
+    std::lock_guard<std::mutex> lock(m_mutexInvalidation);
+    if (m_mapInvalidationThreads.find(sEndpoint) != m_mapInvalidationThreads.end()) return true;
+    m_mapInvalidationThreads.insert({sEndpoint, std::thread(&RedisManager::invalidationWorker, this, stOptions)});
+    return true;
+}
+
+void RedisManager::invalidationWorker(sw::redis::ConnectionOptions stOptions) {
+    // wake up every second to check the stop flag
+    stOptions.socket_timeout = std::chrono::seconds(1);
+    std::string sPrefix = "__keyspace@" + std::to_string(stOptions.db) + "__:";
+    while (!m_bStopInvalidation) {
+        try {
+            sw::redis::Redis redis(stOptions);
+            auto stSubscriber = redis.subscriber();
+            stSubscriber.on_pmessage([&](std::string sPattern, std::string sChannel, std::string sEvent) {
+                if (sChannel.compare(0, sPrefix.size(), sPrefix) != 0) return;
+                m_stReadCache.invalidate(cacheKey(stOptions, std::string_view(sChannel).substr(sPrefix.size())));
+            });
+            stSubscriber.psubscribe(sPrefix + "*");
+            while (!m_bStopInvalidation) {
+                try {
+                    stSubscriber.consume();
+                } catch (const sw::redis::TimeoutError& e) {
+                    continue;
+                }
+            }
+        } catch (const sw::redis::Error& e) {
+            printf("RedisManager::invalidationWorker %s\n", e.what());
+            // notifications may be lost while disconnected
+            m_stReadCache.clear();
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+}
+
+void RedisManager::enableWriteBehind(size_t nFailures, std::chrono::milliseconds stCooldown, 
+                                    std::chrono::milliseconds stConnectTimeout, 
+                                    const std::string& sSpillFile, size_t nReplayBatch) {
+    stopReplay();
+    m_nFailureThreshold = std::max<size_t>(nFailures, 1);
+    m_stCooldown = stCooldown;
+    m_stConnectTimeout = stConnectTimeout;
+    m_nReplayBatch = std::max<size_t>(nReplayBatch, 1);
+    if (!sSpillFile.empty() && !m_stWriteBehind.openSpillFile(sSpillFile)) {
+        printf("RedisManager: open spill file [%s] failed, buffer in memory only\n", sSpillFile.c_str());
+    }
+    m_bStopReplay = false;
+    m_bWriteBehind = true;
+    m_stReplayThread = std::thread(&RedisManager::replayWorker, this);
+}
+
+void RedisManager::disableWriteBehind() {
+    stopReplay();
+    // set() still buffers while pending, the last round may not race direct writes
+    m_bStopReplay = false;
+    for (const auto& sEndpoint : m_stWriteBehind.endpoints()) {
+        sw::redis::ConnectionOptions stOptions;
+        {
+            std::lock_guard<std::mutex> lock(m_mutexHealth);
+            auto itr = m_mapHealth.find(sEndpoint);
+            if (itr == m_mapHealth.end()) continue;
+            stOptions = itr->second.stOptions;
+        }
+        replayEndpoint(sEndpoint, stOptions);
+    }
+    m_bStopReplay = true;
+    m_bWriteBehind = false;
+    // a later enable must not replay them over the direct writes from now on
+    size_t nDropped = m_stWriteBehind.clear();
+    m_stWriteBehind.closeSpillFile();
+    if (nDropped > 0) printf("RedisManager: write behind disabled, %zu buffered writes dropped\n", nDropped);
+    std::lock_guard<std::mutex> lock(m_mutexHealth);
+    m_mapHealth.clear();
+}
+
+void RedisManager::stopReplay() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutexReplay);
+        m_bStopReplay = true;
+    }
+    m_cvReplay.notify_all();
+    if (m_stReplayThread.joinable()) m_stReplayThread.join();
+}
+
+size_t RedisManager::getPendingWrites() const {
+    return m_stWriteBehind.pending();
+}
+
+bool RedisManager::shouldBuffer(const std::string& sEndpoint, const sw::redis::ConnectionOptions& stOptions) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutexHealth);
+        // replayWorker needs the connect options, ex: for entries spilled by a previous run
+        EndpointHealth& stHealth = m_mapHealth[sEndpoint];
+        stHealth.stOptions = stOptions;
+        // older values taken for replay must not overwrite a newer direct write
+        if (stHealth.bOpen || stHealth.bReplaying) return true;
+    }
+    // nor those still waiting for it
+    return m_stWriteBehind.pending(sEndpoint) > 0;
+}
+
+bool RedisManager::recordResult(const std::string& sEndpoint, const sw::redis::ConnectionOptions& stOptions, bool bSuccess) {
+    std::lock_guard<std::mutex> lock(m_mutexHealth);
+    EndpointHealth& stHealth = m_mapHealth[sEndpoint];
+    stHealth.stOptions = stOptions;
+    if (bSuccess) {
+        stHealth.nFailures = 0;
+        stHealth.bOpen = false;
+        return false;
+    }
+    ++stHealth.nFailures;
+    if (stHealth.nFailures >= m_nFailureThreshold) {
+        if (!stHealth.bOpen) {
+            printf("RedisManager: endpoint [%s] failed %zu times, buffer writes\n", sEndpoint.c_str(), stHealth.nFailures);
+        }
+        stHealth.bOpen = true;
+        stHealth.stRetryTime = std::chrono::steady_clock::now() + m_stCooldown.load();
+    }
+    return stHealth.bOpen;
+}
+
+void RedisManager::replayWorker() {
+    while (!m_bStopReplay) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutexReplay);
+            m_cvReplay.wait_for(lock, std::chrono::seconds(1), [this] { return m_bStopReplay.load(); });
+        }
+        if (m_bStopReplay) break;
+
+        auto stNow = std::chrono::steady_clock::now();
+        for (const auto& sEndpoint : m_stWriteBehind.endpoints()) {
+            sw::redis::ConnectionOptions stOptions;
+            {
+                std::lock_guard<std::mutex> lock(m_mutexHealth);
+                auto itr = m_mapHealth.find(sEndpoint);
+                // spilled by a previous run, wait until a task of this endpoint writes again
+                if (itr == m_mapHealth.end()) continue;
+                if (itr->second.bOpen && stNow < itr->second.stRetryTime) continue;
+                stOptions = itr->second.stOptions;
+            }
+            recordResult(sEndpoint, stOptions, replayEndpoint(sEndpoint, stOptions));
+        }
+    }
+}
+
+bool RedisManager::replayEndpoint(const std::string& sEndpoint, const sw::redis::ConnectionOptions& stOptions) {
+    // set() buffers until the last batch is acknowledged, flag raised before the first take
+    auto funReplaying = [this, &sEndpoint](bool bReplaying) {
+        std::lock_guard<std::mutex> lock(m_mutexHealth);
+        m_mapHealth[sEndpoint].bReplaying = bReplaying;
+    };
+    funReplaying(true);
+    bool bRes = true;
+    try {
+        sw::redis::Redis redis(stOptions);
+        redis.ping();
+        while (!m_bStopReplay) {
+            auto vEntries = m_stWriteBehind.take(sEndpoint, m_nReplayBatch);
+            if (vEntries.empty()) break;
+            ScopedLatency stTimer(m_stLatency.histogram("replay", sEndpoint));
+            try {
+                auto stPipe = redis.pipeline(false);
+                for (const auto& stEntry : vEntries) {
+                    stPipe.set(stEntry.sKey, stEntry.sValue, std::chrono::hours(m_nKeepHour));
+                }
+                stPipe.exec();
+                m_stWriteBehind.commit();
+            } catch (const sw::redis::Error& e) {
+                stTimer.fail();
+                m_stWriteBehind.restore(sEndpoint, vEntries);
+                throw;
+            }
+        }
+    } catch (const sw::redis::Error& e) {
+        printf("RedisManager::replayEndpoint [%s] %s\n", sEndpoint.c_str(), e.what());
+        bRes = false;
+    }
+    // writes buffered after the last take wait for the next round
+    funReplaying(false);
+    return bRes;
+}
+
+std::vector<OpStats> RedisManager::getOpStats() const {
+    return m_stLatency.snapshot();
+}
+
+void RedisManager::resetOpStats() {
+    m_stLatency.reset();
+}
+
+void RedisManager::printOpStats() const {
+    for (const auto& stStats : m_stLatency.snapshot()) {
+        if (stStats.nCount == 0) continue;
+        printf("%-8s %-24s count %llu errors %llu mean %.1fus p50 %lluus p99 %lluus max %lluus\n", 
+                stStats.sOp.c_str(), stStats.sEndpoint.c_str(), 
+                (unsigned long long)stStats.nCount, (unsigned long long)stStats.nErrors, stStats.fMeanMicros,
+                (unsigned long long)stStats.nP50Micros, (unsigned long long)stStats.nP99Micros, 
+                (unsigned long long)stStats.nMaxMicros);
+    }
+}
+
 } // end of namespace Haige
\ No newline at end of file
@@ -1,15 +1,32 @@
 #pragma once 
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include <sw/redis++/redis++.h>
 
+#include "LatencyStats.hpp"
+#include "ReadCache.hpp"
+#include "TaskIdIndex.hpp"
+#include "WriteBehindBuffer.hpp"
+
 namespace Haige {
 
+struct EndpointHealth {
+    sw::redis::ConnectionOptions stOptions;
+    size_t nFailures = 0;
+    bool bOpen = false;     // circuit open, writes are buffered
+    bool bReplaying = false;    // replay in flight, direct writes would race it
+    std::chrono::steady_clock::time_point stRetryTime;
+};
+
 struct RedisConnectInfo {
     sw::redis::ConnectionOptions stRedisOptions;
     std::chrono::steady_clock::time_point stLastUsedTime;
@@ -19,6 +36,17 @@ struct RedisConnectInfo {
     }
 };
 
+// parse "http://host[:port]" into connect options
+bool parseRedisAddr(const std::string& sRedisAddr, const std::string& sRedisPs, int nRedisDB, 
+                    sw::redis::ConnectionOptions& stOptions);
+
+// how updateProgress delivers a progress value, can be combined
+enum ProgressPublishMode {
+    PROGRESS_SET = 1,       // SET GEN_MODELING:<taskId>, clients poll
+    PROGRESS_PUBLISH = 2,   // PUBLISH to channel GEN_MODELING:<taskId>
+    PROGRESS_STREAM = 4,    // XADD to capped stream GEN_MODELING_STREAM:<taskId>
+};
+
 class RedisManager {
 public:
     static RedisManager& getInstance() {
@@ -31,30 +59,99 @@ public:
 
     bool registRedisAddr(const std::string& sTaskId, const std::string& sRedisAddr, const std::string& sRedisPs, 
                         int nRedisDB = 0, const std::vector<std::string>& vTaskIds = std::vector<std::string>());
+    // add sub task ids under any registered (main or sub) task id
+    bool registSubTaskIds(const std::string& sParentTaskId, const std::vector<std::string>& vTaskIds);
     void unregistRedisAddr(const std::string& sTaskId);
     bool updateProgress(const std::string& sTaskId, float fProgress, const std::string& sMessage);
     bool updateProgressAssync(const std::string& sTaskId, float fProgress, const std::string& sMessage);
+    // nMode: combination of ProgressPublishMode, nStreamMaxLen: approximate cap of each stream
+    void setProgressPublishMode(int nMode, long long nStreamMaxLen = 1000);
     bool set(const std::string& pKey, const std::string& pValue, const std::string& sTaskId);
     bool set_v2(const std::string& pKey, const std::string& pValue, const std::string& sTaskId);
-    std::string get(const std::string& pKey, const std::string& sTaskId);
+    // stCacheTtl: 0 use the read cache default ttl, < 0 bypass the read cache for this key
+    std::string get(const std::string& pKey, const std::string& sTaskId, 
+                    std::chrono::milliseconds stCacheTtl = std::chrono::milliseconds(0));
     bool del(const std::string& pKey, const std::string& sTaskId);
 
+    // read-through cache for get, invalidated by set/del of this process
+    void enableReadCache(size_t nMaxEntries = 1024, std::chrono::milliseconds stDefaultTtl = std::chrono::seconds(5));
+    void disableReadCache();
+    ReadCacheStats getReadCacheStats() const;
+    // also invalidate on writes of other processes, redis needs notify-keyspace-events including "K$g"
+    bool subscribeInvalidation(const std::string& sTaskId);
+
+    // circuit breaker for set: after nFailures consecutive failures of an endpoint, writes go to memory 
+    // (latest value per key, optionally spilled to sSpillFile) and are replayed in batches once it answers again
+    void enableWriteBehind(size_t nFailures = 3, 
+                        std::chrono::milliseconds stCooldown = std::chrono::seconds(5),
+                        std::chrono::milliseconds stConnectTimeout = std::chrono::milliseconds(500),
+                        const std::string& sSpillFile = "",
+                        size_t nReplayBatch = 100);
+    // replays what is buffered once more and drops what still fails, later direct writes are newer
+    void disableWriteBehind();
+    size_t getPendingWrites() const;
+
+    // latency histograms of set/set_v2/get/del/publish/replay per endpoint
+    std::vector<OpStats> getOpStats() const;
+    void resetOpStats();
+    void printOpStats() const;
 
     void setValid(bool bValid = true);
 private:
     RedisManager();
-    ~RedisManager() {}
+    ~RedisManager();
     
     std::shared_ptr<sw::redis::Redis> getRedis(const std::string& sTaskId); 
+    // copy out connect options and pKey + leaf task ids of sTaskId, false if not registered
+    bool resolveTask(const std::string& sTaskId, const std::string& pKey, 
+                    sw::redis::ConnectionOptions& stOptions, std::vector<std::string>& vKeys);
+    bool publishProgress(const std::string& pValue, const std::string& sTaskId);
+    static std::string endpointOf(const sw::redis::ConnectionOptions& stOptions);
+    static std::string cacheKey(const sw::redis::ConnectionOptions& stOptions, std::string_view sKey);
+    void invalidationWorker(sw::redis::ConnectionOptions stOptions);
+    // true if writes to sEndpoint should be buffered instead of sent
+    bool shouldBuffer(const std::string& sEndpoint, const sw::redis::ConnectionOptions& stOptions);
+    // true if the circuit of sEndpoint is open afterwards
+    bool recordResult(const std::string& sEndpoint, const sw::redis::ConnectionOptions& stOptions, bool bSuccess);
+    // join replayWorker, pending entries and the spill file stay for a later enable or restart
+    void stopReplay();
+    void replayWorker();
+    bool replayEndpoint(const std::string& sEndpoint, const sw::redis::ConnectionOptions& stOptions);
 
 private:
     sw::redis::ConnectionPoolOptions m_stConnectionPoolOpt;
-    std::unordered_map<std::string, RedisConnectInfo> m_mapRedisOptions;
-    std::unordered_map<std::string, std::shared_ptr<sw::redis::Redis> > m_mapRedis;
-    std::unordered_map<std::string, std::vector<std::string> > m_mapSubTaskIds;
+    // main task id -> connect info, sub task ids at any depth route to their main task
+    TaskIdIndex<RedisConnectInfo> m_stTaskIndex;
+    std::unordered_map<std::string, std::shared_ptr<sw::redis::Redis>, TaskIdHash, std::equal_to<> > m_mapRedis;
     bool m_bValid = true;
     size_t m_nKeepHour = 72;
+    std::atomic<int> m_nPublishMode = PROGRESS_SET;
+    std::atomic<long long> m_nStreamMaxLen = 1000;
     std::mutex m_mutex;
+    std::mutex m_mutexIndex;
+
+    std::atomic<bool> m_bReadCache = false;
+    ReadCache m_stReadCache;
+    std::atomic<bool> m_bStopInvalidation = false;
+    // endpoint -> keyspace notification listener
+    std::unordered_map<std::string, std::thread> m_mapInvalidationThreads;
+    std::mutex m_mutexInvalidation;
+
+    std::atomic<bool> m_bWriteBehind = false;
+    // read by set() and recordResult while enableWriteBehind rewrites them
+    std::atomic<size_t> m_nFailureThreshold = 3;
+    size_t m_nReplayBatch = 100;
+    std::atomic<std::chrono::milliseconds> m_stCooldown = std::chrono::milliseconds(5000);
+    std::atomic<std::chrono::milliseconds> m_stConnectTimeout = std::chrono::milliseconds(500);
+    WriteBehindBuffer m_stWriteBehind;
+    std::unordered_map<std::string, EndpointHealth, TaskIdHash, std::equal_to<> > m_mapHealth;
+    std::mutex m_mutexHealth;
+    std::thread m_stReplayThread;
+    std::atomic<bool> m_bStopReplay = false;
+    std::condition_variable m_cvReplay;
+    std::mutex m_mutexReplay;
+
+    LatencyRegistry m_stLatency;
 };
 
 } // end of namespace Haige
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// parent/child index of task ids, ex: main task -> sub tasks -> sub sub tasks
+// lookup by any id is one hash probe on a string_view, no temporary string
+
+namespace Haige {
+
+struct TaskIdHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view sId) const {
+        return std::hash<std::string_view>{}(sId);
+    }
+};
+
+template <typename Info>
+class TaskIdIndex {
+public:
+    struct Node {
+        std::string_view sId;               // view of the key owned by the index
+        Node* pParent = nullptr;
+        Node* pRoot = nullptr;              // main task, owner of pInfo
+        std::vector<Node*> vChildren;
+        std::unique_ptr<Info> pInfo;        // only set on root nodes
+
+        bool isRoot() const { return pParent == nullptr; }
+        bool isLeaf() const { return vChildren.empty(); }
+        Info& info() const { return *pRoot->pInfo; }
+    };
+
+    // add a main task id, return the existing node if already registered
+    Node* insertRoot(const std::string& sId, Info stInfo) {
+        auto [itr, bInserted] = m_mapNodes.try_emplace(sId);
+        Node& stNode = itr->second;
+        if (bInserted) {
+            stNode.sId = itr->first;
+            stNode.pRoot = &stNode;
+            stNode.pInfo = std::make_unique<Info>(std::move(stInfo));
+        }
+        return &stNode;
+    }
+
+    // add sId under sParentId at any depth, nullptr if the parent is unknown
+    Node* insertChild(const std::string& sId, std::string_view sParentId) {
+        Node* pParent = find(sParentId);
+        if (pParent == nullptr) return nullptr;
+
+        auto [itr, bInserted] = m_mapNodes.try_emplace(sId);
+        Node& stNode = itr->second;
+        if (bInserted) {
+            stNode.sId = itr->first;
+            stNode.pParent = pParent;
+            stNode.pRoot = pParent->pRoot;
+            pParent->vChildren.push_back(&stNode);
+        }
+        return &stNode;
+    }
+
+    Node* find(std::string_view sId) {
+        auto itr = m_mapNodes.find(sId);
+        return (itr == m_mapNodes.end() ? nullptr : &itr->second);
+    }
+
+    const Node* find(std::string_view sId) const {
+        auto itr = m_mapNodes.find(sId);
+        return (itr == m_mapNodes.end() ? nullptr : &itr->second);
+    }
+
+    // remove sId and all of its descendants
+    void erase(std::string_view sId) {
+        Node* pNode = find(sId);
+        if (pNode == nullptr) return;
+
+        if (pNode->pParent != nullptr) {
+            auto& vSiblings = pNode->pParent->vChildren;
+            for (auto itr = vSiblings.begin(); itr != vSiblings.end(); ++itr) {
+                if (*itr == pNode) {
+                    vSiblings.erase(itr);
+                    break;
+                }
+            }
+        }
+        eraseSubtree(pNode);
+    }
+
+    // remove every main task (and its subtree) matching funPred(const Info&)
+    template <typename Pred>
+    void eraseRootsIf(Pred&& funPred) {
+        std::vector<Node*> vRoots;
+        for (auto& item : m_mapNodes) {
+            if (item.second.isRoot() && funPred(*item.second.pInfo)) {
+                vRoots.push_back(&item.second);
+            }
+        }
+        for (Node* pRoot : vRoots) {
+            eraseSubtree(pRoot);
+        }
+    }
+
+    // visit the ids of all leaves under pNode, pNode itself if it has no children
+    template <typename Func>
+    void forEachLeaf(const Node* pNode, Func&& funVisit) const {
+        if (pNode->isLeaf()) {
+            funVisit(pNode->sId);
+            return;
+        }
+        for (const Node* pChild : pNode->vChildren) {
+            forEachLeaf(pChild, funVisit);
+        }
+    }
+
+    size_t size() const { return m_mapNodes.size(); }
+    bool empty() const { return m_mapNodes.empty(); }
+    void clear() { m_mapNodes.clear(); }
+
+private:
+    void eraseSubtree(Node* pNode) {
+        for (Node* pChild : pNode->vChildren) {
+            eraseSubtree(pChild);
+        }
+        // pNode->sId views the key, so erase by iterator before it dangles
+        m_mapNodes.erase(m_mapNodes.find(pNode->sId));
+    }
+
+private:
+    std::unordered_map<std::string, Node, TaskIdHash, std::equal_to<> > m_mapNodes;
+};
+
+} // end of namespace Haige
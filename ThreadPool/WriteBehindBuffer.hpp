@@ -0,0 +1,154 @@
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "TaskIdIndex.hpp"
+
+// latest value per key of writes that could not reach their endpoint yet, optionally spilled
+// to an append-only file so a restart can still replay them
+// record format: "<endpoint len> <key len> <value len>\n<endpoint><key><value>\n"
+
+namespace Haige {
+
+class WriteBehindBuffer {
+public:
+    struct Entry {
+        std::string sKey;
+        std::string sValue;
+    };
+
+    WriteBehindBuffer() {}
+    ~WriteBehindBuffer() {
+        closeSpillFile();
+    }
+
+    WriteBehindBuffer(const WriteBehindBuffer&) = delete;
+    WriteBehindBuffer& operator = (const WriteBehindBuffer&) = delete;
+
+    // load records left by a previous run, then append new writes to sPath
+    bool openSpillFile(const std::string& sPath) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_fsSpill.is_open()) m_fsSpill.close();
+        m_sSpillPath = sPath;
+        {
+            std::ifstream fsIn(sPath, std::ios::binary);
+            size_t nEndpointLen = 0, nKeyLen = 0, nValueLen = 0;
+            while (fsIn >> nEndpointLen >> nKeyLen >> nValueLen) {
+                fsIn.get();
+                std::string sRecord(nEndpointLen + nKeyLen + nValueLen, '\0');
+                if (!fsIn.read(sRecord.data(), sRecord.size())) break;
+                fsIn.get();
+                m_mapPending[sRecord.substr(0, nEndpointLen)][sRecord.substr(nEndpointLen, nKeyLen)]
+                    = sRecord.substr(nEndpointLen + nKeyLen);
+            }
+        }
+        m_fsSpill.open(sPath, std::ios::binary | std::ios::app);
+        return m_fsSpill.is_open();
+    }
+
+    void closeSpillFile() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_fsSpill.is_open()) m_fsSpill.close();
+        m_sSpillPath.clear();
+    }
+
+    void push(const std::string& sEndpoint, const std::string& sKey, const std::string& sValue) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapPending[sEndpoint][sKey] = sValue;
+        spill(sEndpoint, sKey, sValue);
+        if (m_fsSpill.is_open()) m_fsSpill.flush();
+    }
+
+    // take at most nMax pending entries of sEndpoint for replay
+    std::vector<Entry> take(std::string_view sEndpoint, size_t nMax) {
+        std::vector<Entry> vEntries;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapPending.find(sEndpoint);
+        if (itr == m_mapPending.end()) return vEntries;
+
+        auto& mapKeys = itr->second;
+        while (!mapKeys.empty() && vEntries.size() < nMax) {
+            auto itrKey = mapKeys.begin();
+            vEntries.push_back({itrKey->first, std::move(itrKey->second)});
+            mapKeys.erase(itrKey);
+        }
+        if (mapKeys.empty()) m_mapPending.erase(itr);
+        return vEntries;
+    }
+
+    // the entries of the last take() reached their endpoint, the spill file keeps them until then
+    void commit() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        truncateIfEmpty();
+    }
+
+    // put back entries whose replay failed, unless a newer value was pushed meanwhile
+    void restore(const std::string& sEndpoint, std::vector<Entry>& vEntries) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& mapKeys = m_mapPending[sEndpoint];
+        for (auto& stEntry : vEntries) {
+            auto stRes = mapKeys.try_emplace(std::move(stEntry.sKey), std::move(stEntry.sValue));
+            // written again in case the file was started over while they were out
+            if (stRes.second) spill(sEndpoint, stRes.first->first, stRes.first->second);
+        }
+        if (m_fsSpill.is_open()) m_fsSpill.flush();
+    }
+
+    // forget all pending entries, the spill file included, returns how many were dropped
+    size_t clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t nCount = 0;
+        for (const auto& item : m_mapPending) nCount += item.second.size();
+        m_mapPending.clear();
+        truncateIfEmpty();
+        return nCount;
+    }
+
+    size_t pending(std::string_view sEndpoint) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto itr = m_mapPending.find(sEndpoint);
+        return (itr == m_mapPending.end() ? 0 : itr->second.size());
+    }
+
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t nCount = 0;
+        for (const auto& item : m_mapPending) nCount += item.second.size();
+        return nCount;
+    }
+
+    std::vector<std::string> endpoints() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<std::string> vEndpoints;
+        for (const auto& item : m_mapPending) vEndpoints.push_back(item.first);
+        return vEndpoints;
+    }
+
+private:
+    void spill(std::string_view sEndpoint, std::string_view sKey, std::string_view sValue) {
+        if (!m_fsSpill.is_open()) return;
+        m_fsSpill << sEndpoint.size() << ' ' << sKey.size() << ' ' << sValue.size() << '\n'
+                << sEndpoint << sKey << sValue << '\n';
+    }
+
+    // everything replayed, start the spill file over
+    void truncateIfEmpty() {
+        if (!m_mapPending.empty() || !m_fsSpill.is_open()) return;
+        m_fsSpill.close();
+        m_fsSpill.open(m_sSpillPath, std::ios::binary | std::ios::trunc);
+    }
+
+private:
+    // endpoint -> key -> latest value
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>, TaskIdHash, std::equal_to<> > m_mapPending;
+    std::string m_sSpillPath;
+    std::ofstream m_fsSpill;
+    mutable std::mutex m_mutex;
+};
+
+} // end of namespace Haige
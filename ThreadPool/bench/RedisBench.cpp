@@ -0,0 +1,136 @@
+// benchmark RedisManager against a local redis-server
+// usage: RedisBench [port=6390] [iterations=10000] [spawn=1]
+// spawn=1 starts "redis-server --port <port>" itself, spawn=0 uses one already listening
+
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../RedisManager.h"
+#include "../ProgressSubscriber.h"
+
+using namespace Haige;
+
+static pid_t startRedisServer(int nPort) {
+    pid_t nPid = fork();
+    if (nPid == 0) {
+        std::string sPort = std::to_string(nPort);
+        execlp("redis-server", "redis-server", "--port", sPort.c_str(), 
+                "--save", "", "--appendonly", "no", "--loglevel", "warning", (char*)nullptr);
+        _exit(127);
+    }
+    return nPid;
+}
+
+static bool waitRedisReady(const sw::redis::ConnectionOptions& stOptions) {
+    for (int i = 0; i < 50; ++i) {
+        try {
+            sw::redis::Redis redis(stOptions);
+            redis.ping();
+            return true;
+        } catch (const sw::redis::Error& e) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    return false;
+}
+
+template <typename Func>
+static void runCase(const char* sName, size_t nIterations, Func&& funOp) {
+    LatencyHistogram stHist;
+    auto stStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nIterations; ++i) {
+        ScopedLatency stTimer(stHist);
+        if (!funOp(i)) stTimer.fail();
+    }
+    double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stStart).count();
+    printf("%-28s %8.0f ops/s  p50 %6lluus  p99 %6lluus  errors %llu\n", sName, nIterations / fSeconds, 
+            (unsigned long long)stHist.percentileMicros(0.5), (unsigned long long)stHist.percentileMicros(0.99),
+            (unsigned long long)stHist.errors());
+}
+
+int main(int argc, char** argv) {
+    int nPort = (argc > 1 ? std::stoi(argv[1]) : 6390);
+    size_t nIterations = (argc > 2 ? std::stoul(argv[2]) : 10000);
+    bool bSpawn = (argc > 3 ? std::stoi(argv[3]) != 0 : true);
+
+    std::string sAddr = "http://127.0.0.1:" + std::to_string(nPort);
+    sw::redis::ConnectionOptions stOptions;
+    parseRedisAddr(sAddr, "", 0, stOptions);
+
+    pid_t nServerPid = (bSpawn ? startRedisServer(nPort) : 0);
+    if (!waitRedisReady(stOptions)) {
+        printf("redis-server on port %d not reachable\n", nPort);
+        if (nServerPid > 0) kill(nServerPid, SIGTERM);
+        return EXIT_FAILURE;
+    }
+
+    RedisManager& stManager = RedisManager::getInstance();
+    std::string sValue = R"({"progress":50,"message":"running"})";
+
+    // single key: connection per call vs pooled
+    stManager.registRedisAddr("bench_single", sAddr, "", 0);
+    runCase("single set (conn per call)", nIterations, [&](size_t) {
+        return stManager.set("GEN_MODELING:", sValue, "bench_single");
+    });
+    runCase("single set_v2 (pooled)", nIterations, [&](size_t) {
+        return stManager.set_v2("GEN_MODELING:", sValue, "bench_single");
+    });
+
+    // sub task fan-out: one call writes 16 keys
+    std::vector<std::string> vSubIds;
+    for (int i = 0; i < 16; ++i) vSubIds.push_back("bench_fan_" + std::to_string(i));
+    stManager.registRedisAddr("bench_fan", sAddr, "", 0, vSubIds);
+    runCase("fan-out x16 set", nIterations / 16 + 1, [&](size_t) {
+        return stManager.set("GEN_MODELING:", sValue, "bench_fan");
+    });
+    runCase("fan-out x16 set_v2", nIterations / 16 + 1, [&](size_t) {
+        return stManager.set_v2("GEN_MODELING:", sValue, "bench_fan");
+    });
+
+    // async publisher: updateProgressAssync -> PUBLISH -> ProgressSubscriber
+    stManager.registRedisAddr("bench_pub", sAddr, "", 0);
+    stManager.setProgressPublishMode(PROGRESS_PUBLISH);
+    LatencyHistogram stDeliver;
+    std::atomic<size_t> nReceived = 0;
+    ProgressSubscriber stSubscriber(stOptions, [&](std::string_view sTaskId, const std::string& sJson) {
+        // message carries the send time in microseconds
+        auto nPos = sJson.find("\"message\":\"");
+        if (nPos == std::string::npos) return;
+        uint64_t nSent = std::stoull(sJson.substr(nPos + 11));
+        uint64_t nNow = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        stDeliver.record(nNow - nSent);
+        ++nReceived;
+    });
+    stSubscriber.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    size_t nPublish = std::min<size_t>(nIterations, 2000);
+    auto stStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nPublish; ++i) {
+        uint64_t nNow = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        stManager.updateProgressAssync("bench_pub", 50, std::to_string(nNow));
+    }
+    while (nReceived < nPublish && std::chrono::steady_clock::now() - stStart < std::chrono::seconds(30)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stStart).count();
+    printf("%-28s %8.0f msg/s  p50 %6lluus  p99 %6lluus  received %zu/%zu\n", "async publish -> subscriber", 
+            nReceived / fSeconds, (unsigned long long)stDeliver.percentileMicros(0.5), 
+            (unsigned long long)stDeliver.percentileMicros(0.99), nReceived.load(), nPublish);
+    stSubscriber.stop();
+    stManager.setProgressPublishMode(PROGRESS_SET);
+
+    printf("\nRedisManager op stats:\n");
+    stManager.printOpStats();
+
+    if (nServerPid > 0) {
+        kill(nServerPid, SIGTERM);
+        waitpid(nServerPid, nullptr, 0);
+    }
+    return EXIT_SUCCESS;
+}